@@ -78,8 +78,7 @@ static QSharedPointer<Ngf::Client> clientInstance()
 DeclarativeNgfEvent::DeclarativeNgfEvent(QObject *parent)
     : QObject(parent)
     , client(clientInstance())
-    , m_status(Stopped)
-    , m_eventId(0)
+    , m_failed(false)
     , m_autostart(false)
     , m_properties()
 {
@@ -95,12 +94,25 @@ DeclarativeNgfEvent::~DeclarativeNgfEvent()
     stop();
 }
 
+DeclarativeNgfEvent::EventStatus DeclarativeNgfEvent::status() const
+{
+    // Status stays as it was until NGF daemon has started the event
+    switch (m_handle.state()) {
+    case Ngf::Client::EventPlaying:
+        return Playing;
+    case Ngf::Client::EventPaused:
+        return Paused;
+    default:
+        return m_failed ? Failed : Stopped;
+    }
+}
+
 void DeclarativeNgfEvent::setEvent(const QString &event)
 {
     if (m_event == event)
         return;
 
-    if (m_eventId) {
+    if (m_handle.isValid()) {
         stop();
         m_autostart = true;
     }
@@ -128,7 +140,7 @@ void DeclarativeNgfEvent::play()
 
     m_autostart = true;
 
-    if (m_eventId)
+    if (m_handle.isValid())
         stop();
 
     if (!m_event.isEmpty() && isConnected()) {
@@ -143,9 +155,9 @@ void DeclarativeNgfEvent::play()
                 if (t == QMetaType::Bool || t == QMetaType::Int || t == QMetaType::QString)
                     prop.insert(property->name(), value);
             }
-            m_eventId = client->play(m_event, prop);
+            m_handle = client->playHandle(m_event, prop);
         } else {
-            m_eventId = client->play(m_event);
+            m_handle = client->playHandle(m_event);
         }
     }
 }
@@ -157,10 +169,10 @@ void DeclarativeNgfEvent::play()
  */
 void DeclarativeNgfEvent::pause()
 {
-    if (!m_eventId)
+    if (!m_handle.isValid())
         return;
 
-    client->pause(m_eventId);
+    m_handle.pause();
 }
 
 /*!
@@ -170,10 +182,10 @@ void DeclarativeNgfEvent::pause()
  */
 void DeclarativeNgfEvent::resume()
 {
-    if (!m_eventId)
+    if (!m_handle.isValid())
         return;
 
-    client->resume(m_eventId);
+    m_handle.resume();
 }
 
 /*!
@@ -185,12 +197,11 @@ void DeclarativeNgfEvent::stop()
 {
     m_autostart = false;
 
-    if (!m_eventId)
+    if (!m_handle.isValid())
         return;
 
-    client->stop(m_eventId);
-    m_eventId = 0;
-    m_status = Stopped;
+    m_handle = Ngf::EventHandle();
+    m_failed = false;
     emit statusChanged();
 }
 
@@ -217,40 +228,38 @@ void DeclarativeNgfEvent::connectionStatusChanged(bool connected)
 
 void DeclarativeNgfEvent::eventFailed(quint32 id)
 {
-    if (id != m_eventId)
+    if (id != m_handle.id())
         return;
 
-    m_eventId = 0;
-    m_status = Failed;
+    m_handle.detach();
+    m_failed = true;
     emit statusChanged();
 }
 
 void DeclarativeNgfEvent::eventCompleted(quint32 id)
 {
-    if (id != m_eventId)
+    if (id != m_handle.id())
         return;
 
-    m_eventId = 0;
-    m_status = Stopped;
+    m_handle.detach();
     emit statusChanged();
 }
 
 void DeclarativeNgfEvent::eventPlaying(quint32 id)
 {
-    if (id != m_eventId)
+    if (id != m_handle.id())
         return;
 
-    m_status = Playing;
+    m_failed = false;
     m_autostart = false;
     emit statusChanged();
 }
 
 void DeclarativeNgfEvent::eventPaused(quint32 id)
 {
-    if (id != m_eventId)
+    if (id != m_handle.id())
         return;
 
-    m_status = Paused;
     emit statusChanged();
 }
 
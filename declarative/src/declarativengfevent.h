@@ -26,13 +26,10 @@
 #include <QVariant>
 #include <QQmlListProperty>
 #include <QVector>
+#include <NgfClient>
 
 #include "declarativengfeventproperty.h"
 
-namespace Ngf {
-    class Client;
-}
-
 class DeclarativeNgfEvent : public QObject
 {
     Q_OBJECT
@@ -58,7 +55,7 @@ public:
     QString event() const { return m_event; }
     void setEvent(const QString &event);
 
-    EventStatus status() const { return m_status; }
+    EventStatus status() const;
 
     QQmlListProperty<DeclarativeNgfEventProperty> properties();
     void appendProperty(DeclarativeNgfEventProperty*);
@@ -111,8 +108,8 @@ private slots:
 private:
     QSharedPointer<Ngf::Client> client;
     QString m_event;
-    EventStatus m_status;
-    quint32 m_eventId;
+    Ngf::EventHandle m_handle;     // Stops the event if it is still playing when destroyed
+    bool m_failed;      // Last event failed and no other one has started since
     bool m_autostart;
 
     static void appendProperty(QQmlListProperty<DeclarativeNgfEventProperty>*, DeclarativeNgfEventProperty*);
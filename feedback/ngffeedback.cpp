@@ -25,6 +25,14 @@
 
 Q_LOGGING_CATEGORY(ngflc, "qt.Feedback.ngf", QtWarningMsg)
 
+// Input effects fire on every press and boundary crossed, far faster than the pulses
+// can be told apart when scrolling quickly
+static const qreal InputEffectRate = 30; // [1/s]
+static const int InputEffectBurst = 5;
+
+// Feedback is pointless when late, an effect NGFD doesn't start promptly is failed
+static const int EffectReplyTimeout = 500; // [ms]
+
 NGFFeedback::NGFFeedback(QObject *parent)
     : QObject(parent)
     , QFeedbackHapticsInterface()
@@ -35,6 +43,8 @@ NGFFeedback::NGFFeedback(QObject *parent)
 {
     qCDebug(ngflc) << "Initializing plugin";
 
+    m_client.setReplyTimeout(EffectReplyTimeout);
+
     if (!m_client.connect()) {
         qCCritical(ngflc) << "Unable to connect to NGFD";
     }
@@ -43,10 +53,6 @@ NGFFeedback::NGFFeedback(QObject *parent)
             this, &NGFFeedback::failed);
     connect(&m_client, &Ngf::Client::eventCompleted,
             this, &NGFFeedback::completed);
-    connect(&m_client, &Ngf::Client::eventPlaying,
-            this, &NGFFeedback::playing);
-    connect(&m_client, &Ngf::Client::eventPaused,
-            this, &NGFFeedback::paused);
 
     m_effects[QFeedbackEffect::Press] = QStringLiteral("feedback_press");
     m_effects[QFeedbackEffect::Release] = QStringLiteral("feedback_release");
@@ -61,6 +67,9 @@ NGFFeedback::NGFFeedback(QObject *parent)
     m_effects[QFeedbackEffect::Appear] = QString();
     m_effects[QFeedbackEffect::Disappear] = QString();
     m_effects[QFeedbackEffect::Move] = QString();
+
+    for (int effect = QFeedbackEffect::Press; effect <= QFeedbackEffect::DragCrossBoundary; ++effect)
+        m_client.setRateLimit(m_effects[effect], InputEffectRate, InputEffectBurst);
 }
 
 NGFFeedback::~NGFFeedback()
@@ -70,40 +79,19 @@ NGFFeedback::~NGFFeedback()
 
 void NGFFeedback::failed(quint32 id)
 {
-    ActiveEffect *active = findEffect(id);
-    if (active)
-        m_activeEffects.removeAll(*active);
+    forgetEffect(id);
     // Can fail just because vibra feedbacks are disabled, so don't whine too loudly here
     qCDebug(ngflc) << "Effect failed, id" << id;
 }
 
 void NGFFeedback::completed(quint32 id)
 {
-    ActiveEffect *active = findEffect(id);
-    if (active)
-        m_activeEffects.removeAll(*active);
+    forgetEffect(id);
     qCDebug(ngflc) << "Effect completed, id" << id;
 }
 
-void NGFFeedback::playing(quint32 id)
-{
-    ActiveEffect *active = findEffect(id);
-    if (active)
-        active->state = QFeedbackEffect::Running;
-    qCDebug(ngflc) << "Effect playing, id" << id;
-}
-
-void NGFFeedback::paused(quint32 id)
-{
-    ActiveEffect *active = findEffect(id);
-    if (active)
-        active->state = QFeedbackEffect::Paused;
-    qCDebug(ngflc) << "Effect paused, id" << id;
-}
-
 bool NGFFeedback::play(QFeedbackEffect::Effect effect)
 {
-    quint32 id;
     switch (effect) {
     case QFeedbackEffect::Press:
     case QFeedbackEffect::Release:
@@ -116,12 +104,11 @@ bool NGFFeedback::play(QFeedbackEffect::Effect effect)
     case QFeedbackEffect::DragDropOutOfZone:
     case QFeedbackEffect::DragCrossBoundary:
         /* These are quick effects and the status can not be retrieved
-         * via effectState() anyway, thus this is not storing the id.
+         * via effectState() anyway, thus these are played without following them.
          */
-        id = m_client.play(m_effects[effect]);
-        if (!id)
+        if (!m_client.playDetached(m_effects[effect]))
             qCWarning(ngflc) << "Could not play effect";
-        qCDebug(ngflc) << "Playing effect #" << effect << "(" << m_effects[effect] << ") with id" << id;
+        qCDebug(ngflc) << "Playing effect #" << effect << "(" << m_effects[effect] << ")";
         return true;
     case QFeedbackEffect::Appear:
     case QFeedbackEffect::Disappear:
@@ -153,11 +140,10 @@ void NGFFeedback::setActuatorProperty(const QFeedbackActuator &, ActuatorPropert
         m_actuatorEnabled = value.toBool();
         if (old != m_actuatorEnabled && !m_actuatorEnabled) {
             // Stop all effects
-            for (auto it = m_activeEffects.begin(); it != m_activeEffects.end(); it = m_activeEffects.erase(it)) {
-                if (!m_client.stop(it->id)) {
-                    qCWarning(ngflc) << "Could not stop effect with id" << it->id;
-                    if (it->effect)
-                        reportError(it->effect, QFeedbackEffect::UnknownError);
+            for (auto it = m_customEffects.begin(); it != m_customEffects.end(); it = m_customEffects.erase(it)) {
+                if (!m_client.stop(it.value().id)) {
+                    qCWarning(ngflc) << "Could not stop effect with id" << it.value().id;
+                    reportError(it.key(), QFeedbackEffect::UnknownError);
                 }
             }
             qCDebug(ngflc) << "Stopped all effects";
@@ -192,8 +178,7 @@ void NGFFeedback::updateEffectProperty(const QFeedbackHapticsEffect *effect, QFe
     if (!m_actuatorEnabled)
         return;
 
-    ActiveEffect *active = findCustomEffect(effect);
-    if (!active)
+    if (!m_customEffects.contains(effect))
         return;
 
     if (prop == QFeedbackHapticsInterface::Duration) {
@@ -207,20 +192,18 @@ void NGFFeedback::setEffectState(const QFeedbackHapticsEffect *effect, QFeedback
     if (!m_actuatorEnabled)
         return;
 
-    ActiveEffect *active = findCustomEffect(effect);
-
     switch (state) {
     case QFeedbackEffect::Running:
-        if (active && active->state == QFeedbackEffect::Paused)
-            resumeCustomEffect(active);
+        if (effectState(effect) == QFeedbackEffect::Paused)
+            resumeCustomEffect(effect);
         else
-            startCustomEffect(active, effect);
+            startCustomEffect(effect);
         break;
     case QFeedbackEffect::Stopped:
-        stopCustomEffect(active);
+        stopCustomEffect(effect);
         break;
     case QFeedbackEffect::Paused:
-        pauseCustomEffect(active);
+        pauseCustomEffect(effect);
         break;
     case QFeedbackEffect::Loading:
     default:
@@ -231,41 +214,34 @@ void NGFFeedback::setEffectState(const QFeedbackHapticsEffect *effect, QFeedback
 
 QFeedbackEffect::State NGFFeedback::effectState(const QFeedbackHapticsEffect *effect)
 {
-    ActiveEffect *active = findCustomEffect(effect);
-    if (active)
-        return active->state;
-    return QFeedbackEffect::Stopped;
+    // The client reports pausing and resuming only once NGFD has done it, which is too
+    // late for starting again right after a pause
+    auto it = m_customEffects.constFind(effect);
+    if (it == m_customEffects.constEnd())
+        return QFeedbackEffect::Stopped;
+    return it.value().state;
 }
 
-NGFFeedback::ActiveEffect *NGFFeedback::findEffect(quint32 id)
+void NGFFeedback::forgetEffect(quint32 id)
 {
     // Assuming that there aren't too many effects
-    for (ActiveEffect &active : m_activeEffects)
-        if (active.id == id)
-            return &active;
-    return nullptr;
-}
-
-NGFFeedback::ActiveEffect *NGFFeedback::findCustomEffect(const QFeedbackHapticsEffect *effect)
-{
-    // Assuming that there aren't too many effects
-    for (ActiveEffect &active : m_activeEffects)
-        if (active.effect == effect)
-            return &active;
-    return nullptr;
+    for (auto it = m_customEffects.begin(); it != m_customEffects.end(); ++it) {
+        if (it.value().id == id) {
+            m_customEffects.erase(it);
+            return;
+        }
+    }
 }
 
-void NGFFeedback::startCustomEffect(ActiveEffect *active, const QFeedbackHapticsEffect *effect)
+void NGFFeedback::startCustomEffect(const QFeedbackHapticsEffect *effect)
 {
     if (effect->duration() > 0) {
         qCDebug(ngflc) << "Playing custom effect due to state change (" << effect->duration() << "ms)";
         QMap<QString, QVariant> properties;
         properties.insert(QStringLiteral("haptic.duration"),
                           QVariant(static_cast<quint32>(effect->duration())));
-        if (active) { // Existing effect
-            m_client.stop(active->id);
-            m_activeEffects.removeAll(*active);
-        }
+        if (m_customEffects.contains(effect)) // Existing effect
+            m_client.stop(m_customEffects.take(effect).id);
         /* The choice of the effect will only affect the strength and style
          * of the feedback. Duration is determined by haptic.duration property
          * which either repeats or "stretches" the effect to the whole duration.
@@ -275,51 +251,48 @@ void NGFFeedback::startCustomEffect(ActiveEffect *active, const QFeedbackHaptics
             qCWarning(ngflc) << "Could not play effect";
             reportError(effect, QFeedbackEffect::UnknownError);
         } else {
-            // Report already the expected state
-            m_activeEffects.append({ id, QFeedbackEffect::Running, const_cast<QFeedbackHapticsEffect *>(effect) });
+            m_customEffects.insert(effect, { id, QFeedbackEffect::Running });
         }
     }
 }
 
-void NGFFeedback::stopCustomEffect(ActiveEffect *active)
+void NGFFeedback::stopCustomEffect(const QFeedbackHapticsEffect *effect)
 {
-    if (active) {
+    if (m_customEffects.contains(effect)) {
         qCDebug(ngflc) << "Stopping custom effect due to state change";
-        if (!m_client.stop(active->id)) {
-            qCWarning(ngflc) << "Could not stop effect with id" << active->id;
-            m_activeEffects.removeAll(*active);
-            reportError(active->effect, QFeedbackEffect::UnknownError);
-        } else {
-            // Report already the expected state
-            active->state = QFeedbackEffect::Stopped;
+        // Stopped effect is forgotten right away, so it is reported stopped already
+        const quint32 id = m_customEffects.take(effect).id;
+        if (!m_client.stop(id)) {
+            qCWarning(ngflc) << "Could not stop effect with id" << id;
+            reportError(effect, QFeedbackEffect::UnknownError);
         }
     }
 }
 
-void NGFFeedback::pauseCustomEffect(ActiveEffect *active)
+void NGFFeedback::pauseCustomEffect(const QFeedbackHapticsEffect *effect)
 {
-    if (active) {
+    if (m_customEffects.contains(effect)) {
         qCDebug(ngflc) << "Pausing custom effect due to state change";
-        if (!m_client.pause(active->id)) {
-            qCWarning(ngflc) << "Could not pause effect with id" << active->id;
-            reportError(active->effect, QFeedbackEffect::UnknownError);
+        CustomEffect &custom = m_customEffects[effect];
+        if (!m_client.pause(custom.id)) {
+            qCWarning(ngflc) << "Could not pause effect with id" << custom.id;
+            reportError(effect, QFeedbackEffect::UnknownError);
         } else {
-            // Report already the expected state
-            active->state = QFeedbackEffect::Paused;
+            custom.state = QFeedbackEffect::Paused;
         }
     }
 }
 
-void NGFFeedback::resumeCustomEffect(ActiveEffect *active)
+void NGFFeedback::resumeCustomEffect(const QFeedbackHapticsEffect *effect)
 {
-    if (active) {
+    if (m_customEffects.contains(effect)) {
         qCDebug(ngflc) << "Resuming custom effect due to state change";
-        if (!m_client.resume(active->id)) {
-            qCWarning(ngflc) << "Could not resume effect with id" << active->id;
-            reportError(active->effect, QFeedbackEffect::UnknownError);
+        CustomEffect &custom = m_customEffects[effect];
+        if (!m_client.resume(custom.id)) {
+            qCWarning(ngflc) << "Could not resume effect with id" << custom.id;
+            reportError(effect, QFeedbackEffect::UnknownError);
         } else {
-            // Report already the expected state
-            active->state = QFeedbackEffect::Running;
+            custom.state = QFeedbackEffect::Running;
         }
     }
 }
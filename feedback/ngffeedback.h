@@ -22,6 +22,7 @@
 #define NGF_FEEDBACK_H
 
 #include <QObject>
+#include <QHash>
 #include <QLoggingCategory>
 #include <qfeedbackplugininterfaces.h>
 #include "ngfclient.h"
@@ -50,31 +51,25 @@ public:
 private slots:
     void failed(quint32 id);
     void completed(quint32 id);
-    void playing(quint32 id);
-    void paused(quint32 id);
 
 private:
-    struct ActiveEffect {
-        quint32 id;
-        QFeedbackEffect::State state;
-        QFeedbackHapticsEffect *effect;
-
-        bool operator==(const ActiveEffect &other) const {
-            return id == other.id && state == other.state && effect == other.effect;
-        }
-    };
-
-    ActiveEffect *findEffect(quint32 id);
-    ActiveEffect *findCustomEffect(const QFeedbackHapticsEffect *effect);
+    void forgetEffect(quint32 id);
 
-    void startCustomEffect(ActiveEffect *active, const QFeedbackHapticsEffect *effect);
-    void stopCustomEffect(ActiveEffect *active);
-    void pauseCustomEffect(ActiveEffect *active);
-    void resumeCustomEffect(ActiveEffect *active);
+    void startCustomEffect(const QFeedbackHapticsEffect *effect);
+    void stopCustomEffect(const QFeedbackHapticsEffect *effect);
+    void pauseCustomEffect(const QFeedbackHapticsEffect *effect);
+    void resumeCustomEffect(const QFeedbackHapticsEffect *effect);
 
     QFeedbackActuator *m_actuator;
     bool m_actuatorEnabled;
-    QVector<ActiveEffect> m_activeEffects;
+    struct CustomEffect {
+        quint32 id;
+        // Requested state, reported already before NGFD has carried out the request
+        QFeedbackEffect::State state;
+    };
+
+    // Event played for each custom effect
+    QHash<const QFeedbackHapticsEffect *, CustomEffect> m_customEffects;
 
     Ngf::Client m_client;
     QString m_effects[QFeedbackEffect::NumberOfEffects];
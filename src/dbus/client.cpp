@@ -59,6 +59,59 @@ quint32 Ngf::Client::play(const QString &event, const QMap<QString, QVariant> &p
     return d_ptr->play(event, properties);
 }
 
+Ngf::PreparedEvent Ngf::Client::prepare(const QString &event, const QMap<QString, QVariant> &properties) const
+{
+    return d_ptr->prepare(event, properties);
+}
+
+quint32 Ngf::Client::play(const QString &event, const QMap<QString, QVariant> &properties,
+                          int replyTimeout)
+{
+    return d_ptr->play(event, properties, replyTimeout);
+}
+
+Ngf::EventHandle Ngf::Client::playHandle(const QString &event,
+                                         const QMap<QString, QVariant> &properties)
+{
+    return d_ptr->playHandle(event, properties);
+}
+
+Ngf::EventHandle Ngf::Client::playHandle(const PreparedEvent &event)
+{
+    return d_ptr->playHandle(event);
+}
+
+QFuture<Ngf::Client::EventResult> Ngf::Client::playAsync(const QString &event,
+                                                          const QMap<QString, QVariant> &properties)
+{
+    return d_ptr->playAsync(event, properties);
+}
+
+QFuture<Ngf::Client::EventResult> Ngf::Client::playAsync(const PreparedEvent &event)
+{
+    return d_ptr->playAsync(event);
+}
+
+quint32 Ngf::Client::play(const PreparedEvent &event)
+{
+    return d_ptr->play(event);
+}
+
+quint32 Ngf::Client::play(const PreparedEvent &event, int replyTimeout)
+{
+    return d_ptr->play(event, replyTimeout);
+}
+
+bool Ngf::Client::playDetached(const QString &event, const QMap<QString, QVariant> &properties)
+{
+    return d_ptr->playDetached(event, properties);
+}
+
+bool Ngf::Client::playDetached(const PreparedEvent &event)
+{
+    return d_ptr->playDetached(event);
+}
+
 bool Ngf::Client::pause(quint32 event_id)
 {
     return d_ptr->pause(event_id);
@@ -88,3 +141,310 @@ bool Ngf::Client::stop(const QString &event)
 {
     return d_ptr->stop(event);
 }
+
+Ngf::Client::EventState Ngf::Client::state(quint32 eventId) const
+{
+    return EventState(d_ptr->state(eventId));
+}
+
+QList<quint32> Ngf::Client::activeEvents() const
+{
+    return d_ptr->activeEvents();
+}
+
+quint32 Ngf::Client::beginBatch()
+{
+    return d_ptr->beginBatch();
+}
+
+QList<quint32> Ngf::Client::commitBatch()
+{
+    return d_ptr->commitBatch();
+}
+
+void Ngf::Client::setCoalescingInterval(int msec)
+{
+    d_ptr->setCoalescingInterval(msec);
+}
+
+int Ngf::Client::coalescingInterval() const
+{
+    return d_ptr->coalescingInterval();
+}
+
+void Ngf::Client::setReplyTimeout(int msec)
+{
+    d_ptr->setReplyTimeout(msec);
+}
+
+int Ngf::Client::replyTimeout() const
+{
+    return d_ptr->replyTimeout();
+}
+
+void Ngf::Client::setMaxInFlight(int requests)
+{
+    d_ptr->setMaxInFlight(requests);
+}
+
+int Ngf::Client::maxInFlight() const
+{
+    return d_ptr->maxInFlight();
+}
+
+void Ngf::Client::setOverflowPolicy(OverflowPolicy policy)
+{
+    d_ptr->setOverflowPolicy(policy);
+}
+
+Ngf::Client::OverflowPolicy Ngf::Client::overflowPolicy() const
+{
+    return OverflowPolicy(d_ptr->overflowPolicy());
+}
+
+void Ngf::Client::setRateLimit(const QString &event, qreal rate, int burst)
+{
+    d_ptr->setRateLimit(event, rate, burst);
+}
+
+void Ngf::Client::setStaleEventTimeout(int msec)
+{
+    d_ptr->setStaleEventTimeout(msec);
+}
+
+int Ngf::Client::staleEventTimeout() const
+{
+    return d_ptr->staleEventTimeout();
+}
+
+void Ngf::Client::setMaxEvents(int events)
+{
+    d_ptr->setMaxEvents(events);
+}
+
+int Ngf::Client::maxEvents() const
+{
+    return d_ptr->maxEvents();
+}
+
+void Ngf::Client::setMaxOfflinePlays(int plays)
+{
+    d_ptr->setMaxOfflinePlays(plays);
+}
+
+int Ngf::Client::maxOfflinePlays() const
+{
+    return d_ptr->maxOfflinePlays();
+}
+
+void Ngf::Client::setOfflineTimeout(int msec)
+{
+    d_ptr->setOfflineTimeout(msec);
+}
+
+int Ngf::Client::offlineTimeout() const
+{
+    return d_ptr->offlineTimeout();
+}
+
+void Ngf::Client::setRecoveryEnabled(bool enabled)
+{
+    d_ptr->setRecoveryEnabled(enabled);
+}
+
+bool Ngf::Client::isRecoveryEnabled() const
+{
+    return d_ptr->isRecoveryEnabled();
+}
+
+void Ngf::Client::setSubscribedWhenIdle(bool subscribed)
+{
+    d_ptr->setSubscribedWhenIdle(subscribed);
+}
+
+bool Ngf::Client::isSubscribedWhenIdle() const
+{
+    return d_ptr->isSubscribedWhenIdle();
+}
+
+void Ngf::Client::setEagerOwnerLookup(bool eager)
+{
+    d_ptr->setEagerOwnerLookup(eager);
+}
+
+bool Ngf::Client::isEagerOwnerLookup() const
+{
+    return d_ptr->isEagerOwnerLookup();
+}
+
+void Ngf::Client::setPrivateConnection(bool enabled)
+{
+    d_ptr->setPrivateConnection(enabled);
+}
+
+bool Ngf::Client::isPrivateConnection() const
+{
+    return d_ptr->isPrivateConnection();
+}
+
+void Ngf::Client::setPeerAddress(const QString &address)
+{
+    d_ptr->setPeerAddress(address);
+}
+
+QString Ngf::Client::peerAddress() const
+{
+    return d_ptr->peerAddress();
+}
+
+void Ngf::Client::setThreadedDispatch(bool enabled)
+{
+    d_ptr->setThreadedDispatch(enabled);
+}
+
+bool Ngf::Client::isThreadedDispatch() const
+{
+    return d_ptr->isThreadedDispatch();
+}
+
+QVariantMap Ngf::Client::statistics() const
+{
+    return d_ptr->statistics();
+}
+
+Ngf::PreparedEvent::PreparedEvent()
+{
+}
+
+Ngf::PreparedEvent::PreparedEvent(PreparedEventData *data)
+    : d(data)
+{
+}
+
+Ngf::PreparedEvent::PreparedEvent(const PreparedEvent &other)
+    : d(other.d)
+{
+}
+
+Ngf::PreparedEvent &Ngf::PreparedEvent::operator=(const PreparedEvent &other)
+{
+    d = other.d;
+    return *this;
+}
+
+Ngf::PreparedEvent::~PreparedEvent()
+{
+}
+
+bool Ngf::PreparedEvent::isValid() const
+{
+    return d.constData() != 0;
+}
+
+QString Ngf::PreparedEvent::event() const
+{
+    return d ? d->event : QString();
+}
+
+QMap<QString, QVariant> Ngf::PreparedEvent::properties() const
+{
+    return d ? d->properties : QMap<QString, QVariant>();
+}
+
+Ngf::EventHandle::EventHandle()
+    : m_id(0), m_slot(-1), m_generation(0)
+{
+}
+
+Ngf::EventHandle::EventHandle(ClientPrivate *client, quint32 id, int slot, quint32 generation)
+    : m_client(client), m_id(id), m_slot(slot), m_generation(generation)
+{
+}
+
+Ngf::EventHandle::EventHandle(EventHandle &&other)
+    : m_client(other.m_client), m_id(other.m_id), m_slot(other.m_slot),
+      m_generation(other.m_generation)
+{
+    other.detach();
+}
+
+Ngf::EventHandle &Ngf::EventHandle::operator=(EventHandle &&other)
+{
+    if (this != &other) {
+        stop();
+        m_client = other.m_client;
+        m_id = other.m_id;
+        m_slot = other.m_slot;
+        m_generation = other.m_generation;
+        other.detach();
+    }
+
+    return *this;
+}
+
+Ngf::EventHandle::~EventHandle()
+{
+    stop();
+}
+
+bool Ngf::EventHandle::isValid() const
+{
+    return m_id != 0;
+}
+
+quint32 Ngf::EventHandle::id() const
+{
+    return m_id;
+}
+
+Ngf::Client::EventState Ngf::EventHandle::state() const
+{
+    if (!m_id || !m_client)
+        return Client::EventUnknown;
+
+    const EventRef ref = { m_slot, m_generation };
+
+    return Client::EventState(m_client->state(m_id, ref));
+}
+
+bool Ngf::EventHandle::pause()
+{
+    if (!m_id || !m_client)
+        return false;
+
+    const EventRef ref = { m_slot, m_generation };
+
+    return m_client->changeState(m_id, ref, StatePaused);
+}
+
+bool Ngf::EventHandle::resume()
+{
+    if (!m_id || !m_client)
+        return false;
+
+    const EventRef ref = { m_slot, m_generation };
+
+    return m_client->changeState(m_id, ref, StatePlaying);
+}
+
+bool Ngf::EventHandle::stop()
+{
+    if (!m_id || !m_client)
+        return false;
+
+    const EventRef ref = { m_slot, m_generation };
+
+    return m_client->changeState(m_id, ref, StateStopped);
+}
+
+quint32 Ngf::EventHandle::detach()
+{
+    const quint32 id = m_id;
+
+    m_client.clear();
+    m_id = 0;
+    m_slot = -1;
+    m_generation = 0;
+
+    return id;
+}
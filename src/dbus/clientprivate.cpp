@@ -18,11 +18,11 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
  */
 
+#include <algorithm>
 #include <QObject>
+#include <QThread>
 #include <QTimer>
 #include <QtDBus>
-#include <QList>
-#include <QtAlgorithms>
 #include "clientprivate.h"
 
 namespace Ngf
@@ -42,27 +42,14 @@ namespace Ngf
     const static QString MethodStop         = "Stop";
     const static QString MethodPause        = "Pause";
     const static QString SignalStatus       = "Status";
-
-    class Event
-    {
-    public:
-        Event(const QString &_name, quint32 _clientEventId, QDBusPendingCallWatcher *_watcher)
-            : name(_name), clientEventId(_clientEventId), serverEventId(0),
-              wantedState(ClientPrivate::StatePlaying),
-              activeState(ClientPrivate::StateNew),
-              pendingState(ClientPrivate::StateNew),
-              watcher(_watcher)
-        {}
-        ~Event() {}
-
-        QString name;
-        quint32 clientEventId;
-        quint32 serverEventId;
-        ClientPrivate::EventState wantedState;
-        ClientPrivate::EventState activeState;
-        ClientPrivate::EventState pendingState;
-        QDBusPendingCallWatcher *watcher;
-    };
+    const static char PeerAddressVariable[] = "NGF_PEER_ADDRESS";
+    const static int DefaultReplyTimeout    = 0; // [ms] Wait as long as D-Bus does
+    const static int UseReplyTimeout        = -1;
+    const static int QuickFailureTime       = 250; // [ms]
+    const static int SweepInterval          = 60000; // [ms]
+    const static int MinSweepInterval       = 100; // [ms]
+    const static quint32 RecoveryBatchIds   = 0x80000000; // Batches replaying held events, from here up
+    const static int DefaultOfflineTimeout  = 5000; // [ms]
 }
 
 QDBusMessage createMethodCall(const QString &method)
@@ -70,36 +57,253 @@ QDBusMessage createMethodCall(const QString &method)
     return QDBusMessage::createMethodCall(Ngf::NgfDestination, Ngf::NgfPath, Ngf::NgfInterface, method);
 }
 
+static uint hashProperties(const Ngf::Proplist &properties);
+
+static uint hashValue(const QVariant &value)
+{
+    // Values are hashed by their type, so lists, maps and byte arrays don't all end up
+    // as an empty string. Equal hashes still get their properties compared.
+    const uint type = uint(value.userType());
+
+    switch (type) {
+    case QMetaType::Bool:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+        return type ^ uint(qHash(value.toULongLong()));
+    case QMetaType::Double:
+        return type ^ uint(qHash(value.toDouble()));
+    case QMetaType::QByteArray:
+        return type ^ uint(qHash(value.toByteArray()));
+    case QMetaType::QVariantMap:
+        return type ^ hashProperties(value.toMap());
+    case QMetaType::QStringList:
+    case QMetaType::QVariantList: {
+        const QVariantList list = value.toList();
+        uint hash = type;
+        for (int i = 0; i < list.size(); ++i)
+            hash = hash * 31 + hashValue(list.at(i));
+        return hash;
+    }
+    default:
+        return type ^ uint(qHash(value.toString()));
+    }
+}
+
+static uint hashProperties(const Ngf::Proplist &properties)
+{
+    uint hash = 0;
+
+    for (Ngf::Proplist::const_iterator it = properties.constBegin(); it != properties.constEnd(); ++it)
+        hash = (hash * 31 + uint(qHash(it.key()))) * 31 + hashValue(it.value());
+
+    return hash;
+}
+
+static Ngf::Proplist playProperties(const QDBusMessage &play)
+{
+    // Play calls carry the event name and its properties
+    return play.arguments().value(1).toMap();
+}
+
+static bool isLocalError(const QDBusMessage &reply)
+{
+    // Errors made up by QtDBus or the bus daemon, NGF daemon never got to fail the event
+    switch (QDBusError(reply).type()) {
+    case QDBusError::NoReply:
+    case QDBusError::Disconnected:
+    case QDBusError::ServiceUnknown:
+    case QDBusError::NoServer:
+    case QDBusError::Timeout:
+    case QDBusError::TimedOut:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool readPlayReply(const QDBusMessage &reply, quint32 *serverEventId)
+{
+    // Play -method reply should contain one argument of type uint32 containing
+    // server side event id for started event.
+    const QList<QVariant> arguments = reply.arguments();
+
+    if (reply.type() != QDBusMessage::ReplyMessage || arguments.count() != 1
+            || arguments.at(0).userType() != QMetaType::UInt)
+        return false;
+
+    *serverEventId = arguments.at(0).toUInt();
+    return true;
+}
+
+Ngf::ReplyReceiver::ReplyReceiver(ClientPrivate *client)
+    : QObject(client),
+      m_client(client)
+{
+}
+
+void Ngf::ReplyReceiver::replied(const QDBusMessage &reply)
+{
+    m_client->callFinished(this, reply);
+}
+
+void Ngf::ReplyReceiver::failed(const QDBusError &error)
+{
+    m_client->callFinished(this, QDBusMessage::createError(error));
+}
+
+void Ngf::ReplyReceiver::notSent()
+{
+    failed(QDBusError(QDBusError::Disconnected, "Not connected to NGF daemon"));
+}
+
 Ngf::ClientPrivate::ClientPrivate(Client *parent)
     : QObject(parent),
       q_ptr(parent),
       m_log("ngf.client"),
-      m_serviceWatcher(0),
+      m_connection(QDBusConnection::systemBus()),
+      m_peerAddress(QString::fromLocal8Bit(qgetenv(PeerAddressVariable))),
+      m_privateConnection(false),
+      m_started(false),
+      m_hub(0),
+      m_hubEntry(-1),
+      m_eagerOwnerLookup(false),
       m_connected(false),
-      m_clientEventId(0)
+      m_subscribed(false),
+      m_subscribedWhenIdle(true),
+      m_clientEventId(0),
+      m_busReplyCount(0),
+      m_peerReplyCount(0),
+      m_busPlayCount(0),
+      m_peerPlayCount(0),
+      m_receiverCount(0),
+      m_playCount(0),
+      m_detachedPlayCount(0),
+      m_batchId(0),
+      m_batchDepth(0),
+      m_batchCount(0),
+      m_flushTimer(this),
+      m_stateRequestCount(0),
+      m_elidedStateRequestCount(0),
+      m_replyTimer(this),
+      m_replyTimeout(DefaultReplyTimeout),
+      m_replyTimeoutCount(0),
+      m_maxInFlight(0),
+      m_overflowPolicy(Client::QueueOverflow),
+      m_congested(false),
+      m_rejecting(0),
+      m_rejectedPlayCount(0),
+      m_droppedPlayCount(0),
+      m_shortCircuitCount(0),
+      m_earlyStatusCount(0),
+      m_sweepTimer(this),
+      m_staleEventTimeout(0),
+      m_maxEvents(0),
+      m_sweepCount(0),
+      m_sweptEventCount(0),
+      m_sweepTime(0),
+      m_recoveryEnabled(false),
+      m_outageStart(-1),
+      m_replayStart(-1),
+      m_replayBatchId(0),
+      m_recoveryCount(0),
+      m_recoveredEventCount(0),
+      m_outageTime(0),
+      m_recoveryTime(0),
+      m_maxOfflinePlays(0),
+      m_offlineTimeout(DefaultOfflineTimeout),
+      m_offlineTimer(this),
+      m_offlinePlayCount(0),
+      m_offlineOverflowCount(0),
+      m_offlineExpiredCount(0),
+      m_queuedRequestCount(0),
+      m_threadedDispatch(false),
+      m_dispatchThread(0)
 {
     m_log.setEnabled(QtDebugMsg, false);
+
+    QObject::connect(this, SIGNAL(connectionStatus(bool)), parent, SIGNAL(connectionStatus(bool)));
+    QObject::connect(this, SIGNAL(eventFailed(quint32)), parent, SIGNAL(eventFailed(quint32)));
+    QObject::connect(this, SIGNAL(eventCompleted(quint32)), parent, SIGNAL(eventCompleted(quint32)));
+    QObject::connect(this, SIGNAL(eventPlaying(quint32)), parent, SIGNAL(eventPlaying(quint32)));
+    QObject::connect(this, SIGNAL(eventPaused(quint32)), parent, SIGNAL(eventPaused(quint32)));
+    QObject::connect(this, SIGNAL(batchFinished(quint32)), parent, SIGNAL(batchFinished(quint32)));
+    QObject::connect(this, SIGNAL(congested()), parent, SIGNAL(congested()));
+    QObject::connect(this, SIGNAL(drained()), parent, SIGNAL(drained()));
+    QObject::connect(this, SIGNAL(eventDropped(QString)), parent, SIGNAL(eventDropped(QString)));
+
+    // By default state requests are flushed on the next pass of the event loop
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(0);
+    m_flushTimer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&m_flushTimer, SIGNAL(timeout()), this, SLOT(flushStateRequests()));
+
+    // One timer serves the reply deadlines of all events
+    m_replyTimer.setSingleShot(true);
+    QObject::connect(&m_replyTimer, SIGNAL(timeout()), this, SLOT(expireReplies()));
+    m_clock.start();
+
+    // Sweeping runs only while there are events and something to enforce
+    m_sweepTimer.setSingleShot(true);
+    QObject::connect(&m_sweepTimer, SIGNAL(timeout()), this, SLOT(sweepEvents()));
+
+    // Plays waiting for NGF daemon to appear fail at their deadlines
+    m_offlineTimer.setSingleShot(true);
+    QObject::connect(&m_offlineTimer, SIGNAL(timeout()), this, SLOT(expireOfflinePlays()));
 }
 
 Ngf::ClientPrivate::~ClientPrivate()
 {
+    stopDispatchThread();
     disconnect();
+
+    // Stopping an event right before deleting the client must still stop it
+    flushStateRequests();
     removeAllEvents();
+
+    // Futures of plays still queued from other threads would never finish otherwise
+    Request *request = m_requests.takeAll();
+
+    while (request) {
+        Request *next = request->next;
+        if (request->waiter)
+            finishWaiter(request->waiter, Client::ResultFailed);
+        delete request;
+        request = next;
+    }
+
+    leaveHub();
+
+    if (!m_peerName.isEmpty()) {
+        unsubscribe();
+        QDBusConnection::disconnectFromPeer(m_peerName);
+    }
+
+    if (!m_busName.isEmpty())
+        QDBusConnection::disconnectFromBus(m_busName);
 }
 
 bool Ngf::ClientPrivate::connect()
 {
-    if (!m_serviceWatcher) {
-        m_serviceWatcher = new QDBusServiceWatcher(NgfDestination,
-                                                   QDBusConnection::systemBus(),
-                                                   QDBusServiceWatcher::WatchForUnregistration,
-                                                   this);
+    bool connected;
+
+    if (m_threadedDispatch && !m_dispatchThread)
+        startDispatchThread();
 
-        QObject::connect(m_serviceWatcher, SIGNAL(serviceUnregistered(const QString&)),
-                         this, SLOT(serviceUnregistered(const QString&)));
+    if (callInDispatchThread("connect", Q_RETURN_ARG(bool, connected)))
+        return connected;
 
-        QDBusConnection::systemBus().connect(QString(), NgfPath, NgfInterface, SignalStatus,
-                                             this, SLOT(setEventState(quint32,quint32)));
+    if (!m_started) {
+        m_started = true;
+        openConnection();
+        if (m_hub && m_eagerOwnerLookup)
+            m_hub->lookUpOwner();
+        updateSubscription();
+    } else if (m_peerName.isEmpty() && !m_hub) {
+        // Left the hub of the thread it was connected in for a dispatch thread
+        joinHub();
+        updateSubscription();
     }
 
     // connected doesn't mean much really, mostly just backward compatibility
@@ -109,77 +313,233 @@ bool Ngf::ClientPrivate::connect()
 
 void Ngf::ClientPrivate::disconnect()
 {
+    if (callInDispatchThread("disconnect"))
+        return;
+
+    // State requests waiting for the next pass of the event loop are sent while the
+    // connection is still in use
+    flushStateRequests();
     changeConnected(false);
 }
 
+void Ngf::ClientPrivate::openConnection()
+{
+    if (!m_peerAddress.isEmpty()) {
+        const QString name = QString("ngf-client-peer-%1").arg(quintptr(this), 0, 16);
+        QDBusConnection peer = QDBusConnection::connectToPeer(m_peerAddress, name);
+
+        if (peer.isConnected()) {
+            qCDebug(m_log) << "connected to NGF daemon peer at" << m_peerAddress;
+            m_connection = peer;
+            m_peerName = name;
+            return;
+        }
+
+        qCWarning(m_log) << "Failed to connect to NGF daemon at" << m_peerAddress
+                         << peer.lastError().message() << "- using system bus";
+        QDBusConnection::disconnectFromPeer(name);
+    }
+
+    useSystemBus();
+}
+
+void Ngf::ClientPrivate::useSystemBus()
+{
+    // Connection of its own keeps requests, replies and status changes from queuing
+    // behind other traffic of the application
+    if (m_privateConnection && m_busName.isEmpty()) {
+        const QString name = QString("ngf-client-bus-%1").arg(quintptr(this), 0, 16);
+        QDBusConnection bus = QDBusConnection::connectToBus(QDBusConnection::SystemBus, name);
+
+        if (bus.isConnected()) {
+            qCDebug(m_log) << "connected to system bus as" << bus.baseService();
+            m_busName = name;
+        } else {
+            qCWarning(m_log) << "Failed to open a system bus connection"
+                             << bus.lastError().message() << "- using the shared one";
+            QDBusConnection::disconnectFromBus(name);
+        }
+    }
+
+    m_connection = m_busName.isEmpty() ? QDBusConnection::systemBus()
+                                       : QDBusConnection(m_busName);
+    joinHub();
+}
+
+void Ngf::ClientPrivate::joinHub()
+{
+    if (m_hub)
+        return;
+
+    // Clients of a thread share one Status match rule and service watcher on the bus
+    m_hub = m_busName.isEmpty() ? StatusHub::acquire(this, &m_hubEntry)
+                                : StatusHub::create(this, &m_hubEntry, m_connection);
+
+    QObject::connect(m_hub, SIGNAL(serviceRegistered(const QString&)),
+                     this, SLOT(serviceRegistered(const QString&)));
+    QObject::connect(m_hub, SIGNAL(serviceUnregistered(const QString&)),
+                     this, SLOT(serviceUnregistered(const QString&)));
+    QObject::connect(m_hub, SIGNAL(serviceOwnerChanged()),
+                     this, SLOT(serviceOwnerChanged()));
+
+    for (int slot = 0; slot < m_events.capacity(); ++slot) {
+        Event *event = m_events.slotAt(slot);
+        if (event && event->serverEventId)
+            m_hub->claim(event->serverEventId, m_hubEntry);
+    }
+
+    if (m_busPlayCount > 0)
+        m_hub->setAwaitingPlays(m_hubEntry, true);
+}
+
+void Ngf::ClientPrivate::leaveHub()
+{
+    if (!m_hub)
+        return;
+
+    unsubscribe();
+    QObject::disconnect(m_hub, 0, this, 0);
+
+    for (int slot = 0; slot < m_events.capacity(); ++slot) {
+        Event *event = m_events.slotAt(slot);
+        if (event && event->serverEventId)
+            m_hub->unclaim(event->serverEventId, m_hubEntry);
+    }
+
+    m_hub->release(m_hubEntry);
+    m_hub = 0;
+    m_hubEntry = -1;
+}
+
+void Ngf::ClientPrivate::checkPeer()
+{
+    // There is no bus daemon telling when the peer goes away, so check the connection
+    // before using it and fall back to the system bus if it has been closed.
+    if (m_peerName.isEmpty() || m_connection.isConnected())
+        return;
+
+    qCWarning(m_log) << "Lost connection to NGF daemon at" << m_peerAddress << "- using system bus";
+
+    unsubscribe();
+    QDBusConnection::disconnectFromPeer(m_peerName);
+    m_peerName.clear();
+    useSystemBus();
+
+    // Events played through the peer are gone with it, and what failed there may not
+    // fail on the system bus
+    removeAllEvents();
+    m_failureCache.clear();
+}
+
+void Ngf::ClientPrivate::serviceRegistered(const QString &service)
+{
+    Q_UNUSED(service);
+
+    if (m_outageStart >= 0) {
+        m_outageTime = m_clock.elapsed() - m_outageStart;
+        m_outageStart = -1;
+        ++m_recoveryCount;
+        qCDebug(m_log) << "NGF daemon back after" << m_outageTime << "ms";
+
+        replayEvents();
+    }
+
+    flushOfflinePlays();
+}
+
 void Ngf::ClientPrivate::serviceUnregistered(const QString &service)
 {
     Q_UNUSED(service);
 
-    // All currently active events are invalid, so clear event list
-    removeAllEvents();
+    // All currently active events are invalid. With recovery, the ones which were
+    // running are kept for playing them again once NGF daemon is back.
+    if (m_recoveryEnabled) {
+        m_outageStart = m_clock.elapsed();
+        holdEvents();
+    } else {
+        removeAllEvents();
+    }
+}
+
+void Ngf::ClientPrivate::serviceOwnerChanged()
+{
+    // New daemon, or one restarted with a new configuration, may play what used to fail
+    m_failureCache.clear();
 }
 
 bool Ngf::ClientPrivate::isConnected()
 {
+    bool connected;
+
+    if (callInDispatchThread("isConnected", Q_RETURN_ARG(bool, connected)))
+        return connected;
+
     return m_connected;
 }
 
 void Ngf::ClientPrivate::setEventState(quint32 serverEventId, quint32 state)
 {
-    Event *event = 0;
+    // Match serverEventId to internal clientEventId. In case of failing or completing
+    // event, the event is removed from the event table before reporting it.
+    Event *event = m_events.byServerId(serverEventId);
 
-    // Look through all ongoing events and match serverEventId to internal clientEventId.
-    // In case of failing or completing event, we'll also remove that event from event list later.
-    for (int i = 0; i < m_events.size(); ++i) {
-        Event *e = m_events.at(i);
-        if (e->serverEventId == serverEventId) {
-            event = e;
-            break;
-        }
+    if (!event) {
+        // Status may overtake the reply to the Play call, keep it for the reply. With no
+        // calls pending it is for an event of some other client.
+        if (inFlight() > 0)
+            m_earlyStatuses.insert(serverEventId, state);
+        return;
     }
 
-    if (!event)
-        return;
+    const quint32 clientEventId = event->clientEventId;
+    const EventRef ref = m_events.ref(event);
 
-    qCDebug(m_log) << event->clientEventId << "server state" << state;
+    qCDebug(m_log) << clientEventId << "server state" << state;
+    event->lastSeen = m_clock.elapsed();
 
     switch (state) {
         case StatusEventFailed:
-            event->activeState = StateStopped;
-            emit q_ptr->eventFailed(event->clientEventId);
-            break;
+            noteFailure(event);
+            removeEvent(event);
+            emit eventFailed(clientEventId);
+            return;
 
         case StatusEventCompleted:
-            event->activeState = StateStopped;
-            emit q_ptr->eventCompleted(event->clientEventId);
-            break;
+            if (!m_failureCache.isEmpty())
+                m_failureCache.succeeded(event->name, event->propertyHash,
+                                         playProperties(event->playCall));
+            resolveWaiter(event, Client::ResultCompleted);
+            removeEvent(event);
+            emit eventCompleted(clientEventId);
+            return;
 
         case StatusEventPlaying:
             if (event->activeState != StatePlaying) {
                 event->activeState = StatePlaying;
-                emit q_ptr->eventPlaying(event->clientEventId);
+                if (event->waiter)
+                    event->waiter->future.setProgressValue(1);
+                emit eventPlaying(clientEventId);
             }
             break;
 
         case StatusEventPaused:
             event->activeState = StatePaused;
-            emit q_ptr->eventPaused(event->clientEventId);
+            emit eventPaused(clientEventId);
             break;
 
         default:
             // Undefined state received from NGFD, probably server
             // DBus API has changed and we are out of sync.
             qCWarning(m_log) << "Client received unknown event state id, likely NGFD API has changed. state:" << state;
-            event->activeState = StateStopped;
-            emit q_ptr->eventFailed(event->clientEventId);
             removeEvent(event);
+            emit eventFailed(clientEventId);
             return;
     }
 
-    if (state == StatusEventFailed || state == StatusEventCompleted) {
-        removeEvent(event);
-    } else if (event->pendingState != StateNew) {
+    // Signal handlers may have modified the event table
+    event = m_events.resolve(ref);
+
+    if (event && event->pendingState != StateNew) {
         requestEventState(event, event->pendingState);
         event->pendingState = StateNew;
     }
@@ -194,171 +554,1725 @@ quint32 Ngf::ClientPrivate::play(const QString &event)
 
 quint32 Ngf::ClientPrivate::play(const QString &event, const Proplist &properties)
 {
-    ++m_clientEventId;
+    return play(event, properties, UseReplyTimeout);
+}
+
+quint32 Ngf::ClientPrivate::play(const QString &event, const Proplist &properties, int replyTimeout)
+{
+    if (!admit(event))
+        return 0;
 
-    // Create asynchronic call to NGFD and connect pending call watcher to slot
-    // playPendingReply where it is finally determined if event is really running
-    // in the NGFD side.
-    QDBusMessage play = createMethodCall(MethodPlay);
+    // The owner of the daemon is known on the client thread only
+    QDBusMessage play = isOwnerThread() ? createCall(MethodPlay) : createMethodCall(MethodPlay);
     play << event << properties;
 
-    QDBusPendingCall pending = QDBusConnection::systemBus().asyncCall(play);
-    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pending, 0);
-    Event *e = new Event(event, m_clientEventId, watcher);
-    m_events.push_back(e);
+    return playMessage(event, play, replyTimeout, hashProperties(properties));
+}
 
-    QObject::connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
-                     this, SLOT(playPendingReply(QDBusPendingCallWatcher*)));
+Ngf::PreparedEvent Ngf::ClientPrivate::prepare(const QString &event, const Proplist &properties) const
+{
+    PreparedEventData *data = new PreparedEventData;
 
-    qCDebug(m_log) << e->clientEventId << "set state" << e->wantedState;
+    data->event = event;
+    data->properties = properties;
+    data->message = createMethodCall(MethodPlay);
+    data->message << event << properties;
+    data->propertyHash = hashProperties(properties);
 
-    return e->clientEventId;
+    return PreparedEvent(data);
 }
 
-void Ngf::ClientPrivate::playPendingReply(QDBusPendingCallWatcher *watcher)
+quint32 Ngf::ClientPrivate::play(const PreparedEvent &event)
 {
-    QDBusPendingReply<quint32> reply = *watcher;
-    int i = 0;
+    return play(event, UseReplyTimeout);
+}
 
-    // Play -method reply should contain one argument of type uint32 containing
-    // server side event id for started event.
+quint32 Ngf::ClientPrivate::play(const PreparedEvent &event, int replyTimeout)
+{
+    if (!event.d || !admit(event.d->event))
+        return 0;
 
-    for (i = 0; i < m_events.size(); ++i) {
-        Event *event = m_events.at(i);
-        if (event->watcher == watcher) {
-            if (reply.isError() || reply.count() != 1) {
-                // Starting event failed for some reason, reason can hopefully be determined from
-                // NGFD logs.
-                quint32 clientEventId = event->clientEventId;
-                removeEvent(event);
-                qCDebug(m_log) << clientEventId << "play: operation failed";
-                emit q_ptr->eventFailed(clientEventId);
-            } else {
-                event->serverEventId = reply.argumentAt<0>();
-                event->watcher = 0;
-                event->activeState = StatePlaying;
-                qCDebug(m_log) << event->clientEventId << "play: server replied" << event->serverEventId;
-                emit q_ptr->eventPlaying(event->clientEventId);
-
-                if (event->pendingState != StateNew) {
-                    qCDebug(m_log) << event->clientEventId
-                                   << "wanted state" << event->pendingState
-                                   << "differs from active state" << event->activeState;
-                    requestEventState(event, event->pendingState);
-                    event->pendingState = StateNew;
-                }
-            }
-            break;
-        }
-    }
+    return playMessage(event.d->event, preparedPlay(event.d.data()), replyTimeout,
+                       event.d->propertyHash);
+}
 
-    watcher->deleteLater();
+Ngf::EventHandle Ngf::ClientPrivate::playHandle(const QString &event, const Proplist &properties)
+{
+    return handle(play(event, properties));
 }
 
-bool Ngf::ClientPrivate::pause(quint32 eventId)
+Ngf::EventHandle Ngf::ClientPrivate::playHandle(const PreparedEvent &event)
 {
-    return changeState(eventId, StatePaused);
+    return handle(play(event));
 }
 
-bool Ngf::ClientPrivate::pause(const QString &event)
+Ngf::EventHandle Ngf::ClientPrivate::handle(quint32 clientEventId)
 {
-    return changeState(event, StatePaused);
+    if (!clientEventId)
+        return EventHandle();
+
+    // Events played on the owner thread are in the table already, the handle keeps
+    // their slot. Others are found by identifier once they have been handed over.
+    const Event *event = isOwnerThread() ? m_events.byClientId(clientEventId) : 0;
+    EventRef ref = { -1, 0 };
+
+    if (event)
+        ref = m_events.ref(event);
+
+    return EventHandle(this, clientEventId, ref.slot, ref.generation);
 }
 
-bool Ngf::ClientPrivate::resume(quint32 eventId)
+QFuture<Ngf::Client::EventResult> Ngf::ClientPrivate::playAsync(const QString &event,
+                                                                 const Proplist &properties)
 {
-    return changeState(eventId, StatePlaying);
+    return await(play(event, properties));
 }
 
-bool Ngf::ClientPrivate::resume(const QString &event)
+QFuture<Ngf::Client::EventResult> Ngf::ClientPrivate::playAsync(const PreparedEvent &event)
 {
-    return changeState(event, StatePlaying);
+    return await(play(event));
 }
 
-bool Ngf::ClientPrivate::stop(quint32 eventId)
+QFuture<Ngf::Client::EventResult> Ngf::ClientPrivate::await(quint32 clientEventId)
 {
-    return changeState(eventId, StateStopped);
+    EventWaiter *waiter = new EventWaiter;
+    QFuture<Client::EventResult> future = waiter->future.future();
+
+    waiter->future.reportStarted();
+    waiter->future.setProgressRange(0, 1);
+
+    if (!clientEventId) {
+        finishWaiter(waiter, Client::ResultFailed);
+    } else if (!isOwnerThread()) {
+        // Handed over after the play request, so the event is in the table by then
+        Request *request = new Request(Request::Await);
+        request->clientEventId = clientEventId;
+        request->waiter = waiter;
+        enqueue(request);
+    } else {
+        attachWaiter(clientEventId, waiter);
+    }
+
+    return future;
 }
 
-bool Ngf::ClientPrivate::stop(const QString &event)
+void Ngf::ClientPrivate::attachWaiter(quint32 clientEventId, EventWaiter *waiter)
 {
-    return changeState(event, StateStopped);
+    Event *event = m_events.byClientId(clientEventId);
+
+    // Plays failed by the failure cache never make it to the table
+    if (!event) {
+        finishWaiter(waiter, Client::ResultFailed);
+        return;
+    }
+
+    event->waiter = waiter;
 }
 
-void Ngf::ClientPrivate::removeEvent(Event *event)
+void Ngf::ClientPrivate::finishWaiter(EventWaiter *waiter, Client::EventResult result)
 {
-    if (m_events.removeOne(event))
-        delete event;
-    else
-        qCWarning(m_log) << "Couldn't find event from event list.";
+    waiter->future.reportResult(result);
+    waiter->future.reportFinished();
+    delete waiter;
 }
 
-void Ngf::ClientPrivate::removeAllEvents()
+void Ngf::ClientPrivate::resolveWaiter(Event *event, Client::EventResult result)
 {
-    qDeleteAll(m_events);
-    m_events.clear();
+    if (!event->waiter)
+        return;
+
+    finishWaiter(event->waiter, result);
+    event->waiter = 0;
 }
 
-bool Ngf::ClientPrivate::changeState(quint32 clientEventId, EventState wantedState)
+bool Ngf::ClientPrivate::playDetached(const QString &event, const Proplist &properties)
 {
-    for (int i = 0; i < m_events.size(); ++i) {
-        Event *e = m_events.at(i);
-        if (e->clientEventId == clientEventId) {
-            requestEventState(e, wantedState);
-            break;
-        }
+    // Dropped plays merge into the ones let through, there's nothing to report back
+    if (!admit(event))
+        return true;
+
+    QDBusMessage play = isOwnerThread() ? createCall(MethodPlay) : createMethodCall(MethodPlay);
+    play << event << properties;
+
+    return sendDetached(play);
+}
+
+bool Ngf::ClientPrivate::playDetached(const PreparedEvent &event)
+{
+    if (!event.d)
+        return false;
+
+    if (!admit(event.d->event))
+        return true;
+
+    return sendDetached(preparedPlay(event.d.data()));
+}
+
+void Ngf::ClientPrivate::setRateLimit(const QString &event, qreal rate, int burst)
+{
+    m_rateLimiter.setLimit(event, rate, burst);
+}
+
+bool Ngf::ClientPrivate::admit(const QString &event)
+{
+    if (m_rateLimiter.admit(event))
+        return true;
+
+    m_droppedPlayCount.fetchAndAddRelaxed(1);
+    qCDebug(m_log) << event << "play: dropped by rate limit";
+    emit eventDropped(event);
+
+    return false;
+}
+
+bool Ngf::ClientPrivate::sendDetached(const QDBusMessage &play)
+{
+    if (!isOwnerThread()) {
+        Request *request = new Request(Request::PlayDetached);
+        request->message = play;
+        enqueue(request);
+        return true;
+    }
+
+    checkPeer();
+
+    // Sending a method call without waiting for the reply flags it as not expecting one
+    if (!m_connection.send(addressed(play))) {
+        qCWarning(m_log) << "Failed to send detached play request";
+        return false;
     }
 
+    ++m_detachedPlayCount;
     return true;
 }
 
-bool Ngf::ClientPrivate::changeState(const QString &clientEventName, EventState wantedState)
+quint32 Ngf::ClientPrivate::playMessage(const QString &event, const QDBusMessage &play, int replyTimeout,
+                                        uint propertyHash)
 {
-    for (int i = 0; i < m_events.size(); ++i) {
-        Event *e = m_events.at(i);
-        if (e->name == clientEventName) {
-            requestEventState(e, wantedState);
-            break;
-        }
+    // Checked without locking so that plays from any thread are refused, plays racing
+    // with the limit being reached are held back instead
+    if (m_rejecting.loadAcquire()) {
+        m_rejectedPlayCount.fetchAndAddRelaxed(1);
+        return 0;
     }
 
-    return true;
+    // Ids are handed out atomically, so callers on other threads get theirs right away
+    const quint32 clientEventId = m_clientEventId.fetchAndAddRelaxed(1) + 1;
+
+    if (!isOwnerThread()) {
+        Request *request = new Request(Request::Play);
+        request->clientEventId = clientEventId;
+        request->name = event;
+        request->message = play;
+        request->replyTimeout = replyTimeout;
+        request->propertyHash = propertyHash;
+        enqueue(request);
+    } else {
+        startEvent(event, play, clientEventId, replyTimeout, propertyHash);
+    }
+
+    return clientEventId;
 }
 
-void Ngf::ClientPrivate::requestEventState(Event *event, EventState wantedState)
+void Ngf::ClientPrivate::startEvent(const QString &event, const QDBusMessage &play, quint32 clientEventId,
+                                    int replyTimeout, uint propertyHash)
 {
-    if (event->wantedState == wantedState
-            || event->activeState == StateStopped) {
+    checkPeer();
+
+    const qint64 now = m_clock.elapsed();
+
+    // Events failing right away over and over again fail without bothering the daemon
+    if (!m_failureCache.isEmpty()
+            && m_failureCache.isBlocked(event, propertyHash, playProperties(play), now)) {
+        ++m_shortCircuitCount;
+        qCDebug(m_log) << clientEventId << "play:" << event << "keeps failing, not sent";
+
+        if (m_cachedFailures.isEmpty())
+            QMetaObject::invokeMethod(this, "reportCachedFailures", Qt::QueuedConnection);
+
+        m_cachedFailures.append(clientEventId);
         return;
-    } else if (event->activeState == StateNew) {
-        // can't make further requests before we have an id from play()
-        event->pendingState = wantedState;
+    }
+
+    // Plays waiting for NGF daemon to appear are limited, plays of an open batch would
+    // join them when committed
+    if (isOffline() && m_offlinePlays.size() + m_batchCalls.size() >= m_maxOfflinePlays) {
+        ++m_offlineOverflowCount;
+        qCDebug(m_log) << clientEventId << "play:" << event << "too many plays waiting for NGF daemon";
+
+        if (m_cachedFailures.isEmpty())
+            QMetaObject::invokeMethod(this, "reportCachedFailures", Qt::QueuedConnection);
+
+        m_cachedFailures.append(clientEventId);
         return;
     }
 
-    event->wantedState = wantedState;
-    qCDebug(m_log) << event->clientEventId << "set state" << event->wantedState;
+    ++m_playCount;
+
+    Event *e = m_events.insert(event, clientEventId);
+    e->propertyHash = propertyHash;
+    e->playCall = play;
+    e->recoverable = m_recoveryEnabled;
+    e->playTime = now;
+    e->lastSeen = now;
+
+    // Going over the table size limit gets the oldest events reclaimed right away
+    if (m_maxEvents > 0 && m_events.count() > m_maxEvents)
+        m_sweepTimer.start(0);
+    else
+        startSweepTimer();
+
+    // Status signals must be received before the daemon gets to play the event
+    if (!m_subscribed)
+        updateSubscription();
+
+    qCDebug(m_log) << e->clientEventId << "set state" << e->wantedState;
+
+    if (m_batchDepth > 0) {
+        BatchCall call;
+        call.message = play;
+        call.event = m_events.ref(e);
+        call.replyTimeout = replyTimeout;
+        m_batchCalls.append(call);
+    } else {
+        sendPlay(e, play, 0, replyTimeout);
+    }
+}
+
+void Ngf::ClientPrivate::sendPlay(Event *event, const QDBusMessage &play, quint32 batchId,
+                                  int replyTimeout)
+{
+    // Plays made before NGF daemon has taken its name would only fail after a round trip
+    if (isOffline()) {
+        HeldPlay held;
+        held.message = play;
+        held.event = m_events.ref(event);
+        held.batchId = batchId;
+        held.replyTimeout = replyTimeout;
+        held.deadline = m_offlineTimeout > 0 ? m_clock.elapsed() + m_offlineTimeout : -1;
+        m_offlinePlays.enqueue(held);
+        ++m_offlinePlayCount;
+
+        qCDebug(m_log) << event->clientEventId << "play: waiting for NGF daemon";
+        if (!m_offlineTimer.isActive())
+            startOfflineTimer();
+        return;
+    }
+
+    // Plays beyond the in-flight limit wait for earlier ones to be replied to, in order
+    if (m_maxInFlight > 0 && (inFlight() >= m_maxInFlight || !m_heldPlays.isEmpty())) {
+        HeldPlay held;
+        held.message = play;
+        held.event = m_events.ref(event);
+        held.batchId = batchId;
+        held.replyTimeout = replyTimeout;
+        held.deadline = -1;
+        m_heldPlays.enqueue(held);
+
+        qCDebug(m_log) << event->clientEventId << "play: held back, in flight" << inFlight();
+        updateCongestion();
+        return;
+    }
+
+    callPlay(event, play, batchId, replyTimeout);
+    updateCongestion();
+}
+
+void Ngf::ClientPrivate::callPlay(Event *event, const QDBusMessage &play, quint32 batchId,
+                                  int replyTimeout)
+{
+    // Reply to the call determines if the event is really running in the NGFD side
+    PendingReply pending;
+    pending.event = m_events.ref(event);
+    pending.clientEventId = event->clientEventId;
+    pending.batchId = batchId;
+    pending.peer = !m_peerName.isEmpty();
+
+    sendCall(play, pending);
+
+    if (replyTimeout < 0)
+        replyTimeout = m_replyTimeout;
+
+    if (replyTimeout > 0) {
+        const qint64 deadline = m_clock.elapsed() + replyTimeout;
+        const bool earliest = m_deadlines.isEmpty() || deadline < m_deadlines.first();
+
+        m_deadlines.insert(deadline, pending.event);
+
+        if (earliest)
+            startReplyTimer();
+    }
+}
+
+int Ngf::ClientPrivate::inFlight() const
+{
+    // State changes sent in batches wait for replies as well, but don't count
+    return m_peerName.isEmpty() ? m_busPlayCount : m_peerPlayCount;
+}
+
+void Ngf::ClientPrivate::releaseHeldPlays()
+{
+    while (!m_heldPlays.isEmpty() && (m_maxInFlight == 0 || inFlight() < m_maxInFlight)) {
+        const HeldPlay held = m_heldPlays.dequeue();
+        Event *event = m_events.resolve(held.event);
+
+        // Events are dropped if NGF daemon went away while they were held back
+        if (event)
+            callPlay(event, held.message, held.batchId, held.replyTimeout);
+        else if (held.batchId)
+            batchCallFinished(held.batchId);
+    }
+
+    updateCongestion();
+}
+
+void Ngf::ClientPrivate::updateCongestion()
+{
+    const int requests = inFlight();
+
+    if (!m_congested) {
+        if (m_maxInFlight == 0 || requests < m_maxInFlight)
+            return;
+    } else if (m_maxInFlight > 0 && (!m_heldPlays.isEmpty() || requests > m_maxInFlight / 2)) {
+        return;
+    }
+
+    m_congested = !m_congested;
+    m_rejecting.storeRelease(m_congested && m_overflowPolicy == Client::RejectOverflow);
+
+    qCDebug(m_log) << "congested" << m_congested << "in flight" << requests;
+
+    if (m_congested)
+        emit congested();
+    else
+        emit drained();
+}
+
+void Ngf::ClientPrivate::setMaxInFlight(int requests)
+{
+    if (callInDispatchThread("setMaxInFlight", QGenericReturnArgument(), Q_ARG(int, requests)))
+        return;
+
+    m_maxInFlight = qMax(0, requests);
+    releaseHeldPlays();
+}
+
+int Ngf::ClientPrivate::maxInFlight() const
+{
+    int requests;
+
+    if (callInDispatchThread("maxInFlight", Q_RETURN_ARG(int, requests)))
+        return requests;
+
+    return m_maxInFlight;
+}
+
+void Ngf::ClientPrivate::setOverflowPolicy(int policy)
+{
+    if (callInDispatchThread("setOverflowPolicy", QGenericReturnArgument(), Q_ARG(int, policy)))
+        return;
+
+    m_overflowPolicy = Client::OverflowPolicy(policy);
+    m_rejecting.storeRelease(m_congested && m_overflowPolicy == Client::RejectOverflow);
+}
+
+int Ngf::ClientPrivate::overflowPolicy() const
+{
+    int policy;
+
+    if (callInDispatchThread("overflowPolicy", Q_RETURN_ARG(int, policy)))
+        return policy;
+
+    return m_overflowPolicy;
+}
+
+void Ngf::ClientPrivate::sendCall(const QDBusMessage &call, const PendingReply &pending)
+{
+    // Errors from the bus daemon or QtDBus aren't ordered with the replies from NGF daemon,
+    // so every call has a receiver of its own. QtDBus doesn't tell the serial a call is
+    // sent with, so the reply can't be looked up by it. Receivers are reused, so steady
+    // state calls don't create any.
+    ReplyReceiver *receiver;
+
+    if (m_freeReceivers.isEmpty()) {
+        receiver = new ReplyReceiver(this);
+        ++m_receiverCount;
+    } else {
+        receiver = m_freeReceivers.takeLast();
+    }
+
+    receiver->pending = pending;
+
+    const bool sent = m_connection.callWithCallback(pending.peer ? call : addressed(call),
+                                                    receiver, SLOT(replied(QDBusMessage)),
+                                                    SLOT(failed(QDBusError)));
+
+    // There won't be any reply, fail the call once the caller has got back control
+    if (!sent) {
+        qCWarning(m_log) << "Failed to send" << call.member() << "request";
+        QMetaObject::invokeMethod(receiver, "notSent", Qt::QueuedConnection);
+    }
+
+    // Replies on a closed peer connection still arrive after falling back to the system bus
+    ++(pending.peer ? m_peerReplyCount : m_busReplyCount);
+    if (pending.event.slot >= 0 && ++(pending.peer ? m_peerPlayCount : m_busPlayCount) == 1
+            && !pending.peer && m_hub)
+        m_hub->setAwaitingPlays(m_hubEntry, true);
+}
+
+void Ngf::ClientPrivate::sendRequest(const QDBusMessage &request)
+{
+    if (m_batchDepth > 0) {
+        BatchCall call;
+        call.message = request;
+        call.event.slot = -1;
+        call.event.generation = 0;
+        call.replyTimeout = 0;
+        m_batchCalls.append(call);
+    } else {
+        m_connection.asyncCall(addressed(request));
+    }
+}
+
+QDBusMessage Ngf::ClientPrivate::createCall(const QString &method) const
+{
+    // Calls made in the client thread go straight to the daemon when its owner is known
+    const QString owner = m_hub ? m_hub->serviceOwner() : QString();
+
+    if (owner.isEmpty())
+        return createMethodCall(method);
+
+    return QDBusMessage::createMethodCall(owner, NgfPath, NgfInterface, method);
+}
+
+QDBusMessage Ngf::ClientPrivate::addressed(const QDBusMessage &call) const
+{
+    // Plays built in other threads or before the owner was known are for the well-known
+    // name. Addressing the unique name of its owner saves the bus daemon from resolving
+    // the name for every call. Calls for a daemon that has since gone are readdressed as
+    // well. Calls already addressed to the owner go as they are.
+    const QString owner = m_hub ? m_hub->serviceOwner() : QString();
+    const QString service = owner.isEmpty() ? NgfDestination : owner;
+
+    if (call.service() == service)
+        return call;
+
+    QDBusMessage readdressed = QDBusMessage::createMethodCall(service, call.path(),
+                                                              call.interface(), call.member());
+    readdressed.setArguments(call.arguments());
+    readdressed.setAutoStartService(call.autoStartService());
+    return readdressed;
+}
+
+QDBusMessage Ngf::ClientPrivate::preparedPlay(PreparedEventData *data) const
+{
+    // Prepared events are usually built before the owner is known. The play addressed to
+    // it is kept with the event and built again only after the owner has changed, other
+    // threads can't tell the owner and use the play as it is.
+    QMutexLocker locker(&data->mutex);
+
+    if (isOwnerThread())
+        data->message = addressed(data->message);
+
+    return data->message;
+}
+
+void Ngf::ClientPrivate::callFinished(ReplyReceiver *receiver, const QDBusMessage &reply)
+{
+    const PendingReply pending = receiver->pending;
+
+    m_freeReceivers.append(receiver);
+    --(pending.peer ? m_peerReplyCount : m_busReplyCount);
+    if (pending.event.slot >= 0 && --(pending.peer ? m_peerPlayCount : m_busPlayCount) == 0
+            && !pending.peer && m_hub)
+        m_hub->setAwaitingPlays(m_hubEntry, false);
+
+    finishCall(pending, reply);
+}
+
+void Ngf::ClientPrivate::finishCall(const PendingReply &pending, const QDBusMessage &reply)
+{
+    if (pending.event.slot >= 0) {
+        if (m_expiredPlays.remove(pending.clientEventId))
+            stopExpiredPlay(pending, reply);
+        else
+            finishPlay(pending.event, reply);
+    }
+
+    if (pending.batchId)
+        batchCallFinished(pending.batchId);
+
+    releaseHeldPlays();
+    checkPeer();
+}
+
+void Ngf::ClientPrivate::finishPlay(const EventRef &ref, const QDBusMessage &reply)
+{
+    Event *event = m_events.resolve(ref);
+
+    // Event is gone if NGF daemon went away meanwhile
+    if (!event)
+        return;
+
+    quint32 serverEventId;
+
+    if (!readPlayReply(reply, &serverEventId)) {
+        // Starting event failed for some reason, reason can hopefully be determined from
+        // NGFD logs.
+        quint32 clientEventId = event->clientEventId;
+        if (!isLocalError(reply))
+            noteFailure(event);
+        removeEvent(event);
+        qCDebug(m_log) << clientEventId << "play: operation failed" << reply.errorMessage();
+        emit eventFailed(clientEventId);
+        return;
+    }
+
+    if (Event *stale = m_events.setServerId(event, serverEventId))
+        qCWarning(m_log) << stale->clientEventId << "lost server id" << serverEventId
+                         << "to" << event->clientEventId;
+    if (m_hub)
+        m_hub->claim(serverEventId, m_hubEntry);
+    event->activeState = StatePlaying;
+    event->lastSeen = m_clock.elapsed();
+    qCDebug(m_log) << event->clientEventId << "play: server replied" << event->serverEventId;
+
+    if (event->waiter)
+        event->waiter->future.setProgressValue(1);
+
+    // Only started events are reclaimed for the table size limit
+    if (m_maxEvents > 0 && m_events.count() > m_maxEvents)
+        m_sweepTimer.start(0);
+    emit eventPlaying(event->clientEventId);
+
+    // Replay what NGF daemon said about the event before replying
+    quint32 state;
+
+    while (!m_earlyStatuses.isEmpty() && m_events.resolve(ref)
+           && m_earlyStatuses.take(serverEventId, &state)) {
+        qCDebug(m_log) << "play: status" << state << "arrived before the reply";
+        ++m_earlyStatusCount;
+        setEventState(serverEventId, state);
+    }
+
+    // Signal handlers may have modified the event table
+    event = m_events.resolve(ref);
+
+    if (event && event->pendingState != StateNew) {
+        qCDebug(m_log) << event->clientEventId
+                       << "wanted state" << event->pendingState
+                       << "differs from active state" << event->activeState;
+        requestEventState(event, event->pendingState);
+        event->pendingState = StateNew;
+    }
+}
+
+void Ngf::ClientPrivate::noteFailure(const Event *event)
+{
+    // Only events failing right after being played tell something about the event
+    const qint64 now = m_clock.elapsed();
+
+    if (now - event->playTime <= QuickFailureTime)
+        m_failureCache.failed(event->name, event->propertyHash, playProperties(event->playCall),
+                              now);
+}
+
+void Ngf::ClientPrivate::reportCachedFailures()
+{
+    QVector<quint32> failures;
+
+    failures.swap(m_cachedFailures);
+
+    for (int i = 0; i < failures.size(); ++i)
+        emit eventFailed(failures.at(i));
+}
+
+void Ngf::ClientPrivate::stopExpiredPlay(const PendingReply &pending, const QDBusMessage &reply)
+{
+    // The event was already reported failed, don't leave it playing unseen. Replies from
+    // a connection no longer in use are for a daemon the events were dropped with.
+    quint32 serverEventId;
+
+    if (pending.peer != !m_peerName.isEmpty() || !readPlayReply(reply, &serverEventId))
+        return;
+
+    qCDebug(m_log) << serverEventId << "play: late reply, stopping";
+    stopServerEvent(serverEventId);
+}
+
+void Ngf::ClientPrivate::stopServerEvent(quint32 serverEventId)
+{
+    // Sent without following the reply, the event is no longer tracked
+    QDBusMessage stop = createCall(MethodStop);
+    stop << serverEventId;
+    m_connection.asyncCall(stop);
+}
+
+void Ngf::ClientPrivate::startReplyTimer()
+{
+    if (m_deadlines.isEmpty()) {
+        m_replyTimer.stop();
+        return;
+    }
+
+    m_replyTimer.start(int(qMax<qint64>(0, m_deadlines.first() - m_clock.elapsed())));
+}
+
+void Ngf::ClientPrivate::expireReplies()
+{
+    const qint64 now = m_clock.elapsed();
+
+    while (!m_deadlines.isEmpty() && m_deadlines.first() <= now) {
+        Event *event = m_events.resolve(m_deadlines.takeFirst());
+
+        // Events which got their reply in time are skipped
+        if (!event || event->activeState != StateNew)
+            continue;
+
+        // The reply is still expected, so the pending call stays queued and only the
+        // event is released now
+        const quint32 clientEventId = event->clientEventId;
+        m_expiredPlays.insert(clientEventId);
+        ++m_replyTimeoutCount;
+        removeEvent(event);
+        qCWarning(m_log) << clientEventId << "play: no reply from NGF daemon in time";
+        emit eventFailed(clientEventId);
+    }
+
+    startReplyTimer();
+}
+
+void Ngf::ClientPrivate::startSweepTimer()
+{
+    if (m_sweepTimer.isActive() || m_events.count() == 0
+            || (m_staleEventTimeout == 0 && m_maxEvents == 0))
+        return;
+
+    // Stale events are found within half the timeout, but no more often than needed
+    const int interval = m_staleEventTimeout > 0
+            ? qBound(MinSweepInterval, m_staleEventTimeout / 2, SweepInterval)
+            : SweepInterval;
+
+    m_sweepTimer.start(interval);
+}
+
+void Ngf::ClientPrivate::sweepEvents()
+{
+    QElapsedTimer cost;
+    cost.start();
+
+    const qint64 now = m_clock.elapsed();
+    const int excess = m_maxEvents > 0 ? m_events.count() - m_maxEvents : 0;
+    int stale = 0;
+
+    // Events still waiting for their reply are left to the reply timeout. When the table
+    // is too big, every other event is a candidate, otherwise only the stale ones.
+    m_sweepCandidates.resize(0);
+
+    for (int slot = 0; slot < m_events.capacity(); ++slot) {
+        const Event *event = m_events.slotAt(slot);
+
+        if (!event || event->activeState == StateNew)
+            continue;
+
+        const bool isStale = m_staleEventTimeout > 0
+                && now - event->lastSeen >= m_staleEventTimeout;
+
+        if (isStale)
+            ++stale;
+
+        if (isStale || excess > 0) {
+            SweepCandidate candidate;
+            candidate.lastSeen = event->lastSeen;
+            candidate.event = m_events.ref(event);
+            m_sweepCandidates.append(candidate);
+        }
+    }
+
+    // Least recently heard of first, so the stale events lead the list
+    const int reclaim = qMin(qMax(stale, excess), m_sweepCandidates.size());
+
+    if (excess > 0)
+        std::partial_sort(m_sweepCandidates.begin(), m_sweepCandidates.begin() + reclaim,
+                          m_sweepCandidates.end());
+
+    for (int i = 0; i < reclaim; ++i) {
+        // Signal handlers may have modified the event table
+        Event *event = m_events.resolve(m_sweepCandidates.at(i).event);
+
+        if (!event)
+            continue;
+
+        const quint32 clientEventId = event->clientEventId;
+        qCWarning(m_log) << clientEventId << "reclaimed, nothing heard of it for"
+                         << now - event->lastSeen << "ms";
+
+        stopServerEvent(event->serverEventId);
+        ++m_sweptEventCount;
+        removeEvent(event);
+        emit eventFailed(clientEventId);
+    }
+
+    ++m_sweepCount;
+    m_sweepTime += cost.nsecsElapsed() / 1000;
+
+    startSweepTimer();
+}
+
+void Ngf::ClientPrivate::setStaleEventTimeout(int msec)
+{
+    if (callInDispatchThread("setStaleEventTimeout", QGenericReturnArgument(), Q_ARG(int, msec)))
+        return;
+
+    m_staleEventTimeout = qMax(0, msec);
+    m_sweepTimer.stop();
+    startSweepTimer();
+}
+
+int Ngf::ClientPrivate::staleEventTimeout() const
+{
+    int msec;
+
+    if (callInDispatchThread("staleEventTimeout", Q_RETURN_ARG(int, msec)))
+        return msec;
+
+    return m_staleEventTimeout;
+}
+
+void Ngf::ClientPrivate::setMaxEvents(int events)
+{
+    if (callInDispatchThread("setMaxEvents", QGenericReturnArgument(), Q_ARG(int, events)))
+        return;
+
+    m_maxEvents = qMax(0, events);
+
+    if (m_maxEvents > 0 && m_events.count() > m_maxEvents) {
+        m_sweepTimer.start(0);
+    } else {
+        m_sweepTimer.stop();
+        startSweepTimer();
+    }
+}
+
+int Ngf::ClientPrivate::maxEvents() const
+{
+    int events;
+
+    if (callInDispatchThread("maxEvents", Q_RETURN_ARG(int, events)))
+        return events;
+
+    return m_maxEvents;
+}
+
+void Ngf::ClientPrivate::setMaxOfflinePlays(int plays)
+{
+    if (callInDispatchThread("setMaxOfflinePlays", QGenericReturnArgument(), Q_ARG(int, plays)))
+        return;
+
+    // Plays already waiting keep waiting
+    m_maxOfflinePlays = qMax(0, plays);
+}
+
+int Ngf::ClientPrivate::maxOfflinePlays() const
+{
+    int plays;
+
+    if (callInDispatchThread("maxOfflinePlays", Q_RETURN_ARG(int, plays)))
+        return plays;
+
+    return m_maxOfflinePlays;
+}
+
+void Ngf::ClientPrivate::setOfflineTimeout(int msec)
+{
+    if (callInDispatchThread("setOfflineTimeout", QGenericReturnArgument(), Q_ARG(int, msec)))
+        return;
+
+    // Applies to plays made from now on
+    m_offlineTimeout = qMax(0, msec);
+}
+
+int Ngf::ClientPrivate::offlineTimeout() const
+{
+    int msec;
+
+    if (callInDispatchThread("offlineTimeout", Q_RETURN_ARG(int, msec)))
+        return msec;
+
+    return m_offlineTimeout;
+}
+
+void Ngf::ClientPrivate::setRecoveryEnabled(bool enabled)
+{
+    if (callInDispatchThread("setRecoveryEnabled", QGenericReturnArgument(), Q_ARG(bool, enabled)))
+        return;
+
+    // Events played before enabling have no play call kept and can't be recovered
+    m_recoveryEnabled = enabled;
+}
+
+bool Ngf::ClientPrivate::isRecoveryEnabled() const
+{
+    bool enabled;
+
+    if (callInDispatchThread("isRecoveryEnabled", Q_RETURN_ARG(bool, enabled)))
+        return enabled;
+
+    return m_recoveryEnabled;
+}
+
+void Ngf::ClientPrivate::setReplyTimeout(int msec)
+{
+    if (callInDispatchThread("setReplyTimeout", QGenericReturnArgument(), Q_ARG(int, msec)))
+        return;
+
+    m_replyTimeout = qMax(0, msec);
+}
+
+int Ngf::ClientPrivate::replyTimeout() const
+{
+    int msec;
+
+    if (callInDispatchThread("replyTimeout", Q_RETURN_ARG(int, msec)))
+        return msec;
+
+    return m_replyTimeout;
+}
+
+void Ngf::ClientPrivate::batchCallFinished(quint32 batchId)
+{
+    QHash<quint32, int>::iterator it = m_batchPending.find(batchId);
+
+    if (it == m_batchPending.end() || --it.value() > 0)
+        return;
+
+    m_batchPending.erase(it);
+
+    // Replays of held events are not batches of the application. Replies to an earlier
+    // replay may still come in after the next one started, only the last one is timed.
+    if (batchId >= RecoveryBatchIds) {
+        if (batchId == m_replayBatchId) {
+            m_recoveryTime = m_clock.elapsed() - m_replayStart;
+            m_replayStart = -1;
+            qCDebug(m_log) << "recovered in" << m_recoveryTime << "ms";
+        }
+        return;
+    }
+
+    qCDebug(m_log) << "batch" << batchId << "finished";
+    emit batchFinished(batchId);
+}
+
+bool Ngf::ClientPrivate::pause(quint32 eventId)
+{
+    return changeState(eventId, StatePaused);
+}
+
+bool Ngf::ClientPrivate::pause(const QString &event)
+{
+    return changeState(event, StatePaused);
+}
+
+bool Ngf::ClientPrivate::resume(quint32 eventId)
+{
+    return changeState(eventId, StatePlaying);
+}
+
+bool Ngf::ClientPrivate::resume(const QString &event)
+{
+    return changeState(event, StatePlaying);
+}
+
+bool Ngf::ClientPrivate::stop(quint32 eventId)
+{
+    return changeState(eventId, StateStopped);
+}
+
+bool Ngf::ClientPrivate::stop(const QString &event)
+{
+    return changeState(event, StateStopped);
+}
+
+quint32 Ngf::ClientPrivate::beginBatch()
+{
+    quint32 batchId;
+
+    if (callInDispatchThread("beginBatch", Q_RETURN_ARG(quint32, batchId)))
+        return batchId;
+
+    // Application batches stay below the ids of replays
+    if (m_batchDepth++ == 0)
+        m_batchId = m_batchId + 1 < RecoveryBatchIds ? m_batchId + 1 : 1;
+
+    return m_batchId;
+}
+
+QList<quint32> Ngf::ClientPrivate::commitBatch()
+{
+    QList<quint32> played;
+
+    if (callInDispatchThread("commitBatch", Q_RETURN_ARG(QList<quint32>, played)))
+        return played;
+
+    if (m_batchDepth == 0)
+        return played;
+
+    // State requests made during the batch are sent with it
+    if (m_batchDepth == 1)
+        flushStateRequests();
+
+    if (--m_batchDepth > 0)
+        return played;
+
+    const quint32 batchId = m_batchId;
+    QVector<BatchCall> calls;
+    int pending = 0;
+
+    checkPeer();
+    calls.swap(m_batchCalls);
+    ++m_batchCount;
+
+    // Send everything before handling any of the replies, so the requests reach
+    // NGF daemon together.
+    for (int i = 0; i < calls.size(); ++i) {
+        const BatchCall &call = calls.at(i);
+
+        if (call.event.slot >= 0) {
+            Event *event = m_events.resolve(call.event);
+
+            // Events are dropped if NGF daemon went away before the batch was committed
+            if (!event)
+                continue;
+
+            played.append(event->clientEventId);
+            sendPlay(event, call.message, batchId, call.replyTimeout);
+        } else {
+            PendingReply pending;
+            pending.event = call.event;
+            pending.clientEventId = 0;
+            pending.batchId = batchId;
+            pending.peer = !m_peerName.isEmpty();
+            sendCall(call.message, pending);
+        }
+
+        ++pending;
+    }
+
+    qCDebug(m_log) << "batch" << batchId << "sent" << pending << "requests";
+
+    if (pending > 0)
+        m_batchPending.insert(batchId, pending);
+    else
+        emit batchFinished(batchId);
+
+    return played;
+}
+
+void Ngf::ClientPrivate::setCoalescingInterval(int msec)
+{
+    if (callInDispatchThread("setCoalescingInterval", QGenericReturnArgument(), Q_ARG(int, msec)))
+        return;
+
+    m_flushTimer.setInterval(qMax(0, msec));
+}
+
+int Ngf::ClientPrivate::coalescingInterval() const
+{
+    int msec;
+
+    if (callInDispatchThread("coalescingInterval", Q_RETURN_ARG(int, msec)))
+        return msec;
+
+    return m_flushTimer.interval();
+}
+
+void Ngf::ClientPrivate::setSubscribedWhenIdle(bool subscribed)
+{
+    if (callInDispatchThread("setSubscribedWhenIdle", QGenericReturnArgument(), Q_ARG(bool, subscribed)))
+        return;
+
+    m_subscribedWhenIdle = subscribed;
+    updateSubscription();
+}
+
+bool Ngf::ClientPrivate::isSubscribedWhenIdle() const
+{
+    bool subscribed;
+
+    if (callInDispatchThread("isSubscribedWhenIdle", Q_RETURN_ARG(bool, subscribed)))
+        return subscribed;
+
+    return m_subscribedWhenIdle;
+}
+
+void Ngf::ClientPrivate::setEagerOwnerLookup(bool eager)
+{
+    if (callInDispatchThread("setEagerOwnerLookup", QGenericReturnArgument(), Q_ARG(bool, eager)))
+        return;
+
+    m_eagerOwnerLookup = eager;
+}
+
+bool Ngf::ClientPrivate::isEagerOwnerLookup() const
+{
+    bool eager;
+
+    if (callInDispatchThread("isEagerOwnerLookup", Q_RETURN_ARG(bool, eager)))
+        return eager;
+
+    return m_eagerOwnerLookup;
+}
+
+void Ngf::ClientPrivate::setPrivateConnection(bool enabled)
+{
+    if (callInDispatchThread("setPrivateConnection", QGenericReturnArgument(), Q_ARG(bool, enabled)))
+        return;
+
+    // Takes effect in connect()
+    m_privateConnection = enabled;
+}
+
+bool Ngf::ClientPrivate::isPrivateConnection() const
+{
+    bool enabled;
+
+    if (callInDispatchThread("isPrivateConnection", Q_RETURN_ARG(bool, enabled)))
+        return enabled;
+
+    return m_privateConnection;
+}
+
+void Ngf::ClientPrivate::setPeerAddress(const QString &address)
+{
+    if (callInDispatchThread("setPeerAddress", QGenericReturnArgument(), Q_ARG(QString, address)))
+        return;
+
+    m_peerAddress = address;
+}
+
+QString Ngf::ClientPrivate::peerAddress() const
+{
+    QString address;
+
+    if (callInDispatchThread("peerAddress", Q_RETURN_ARG(QString, address)))
+        return address;
+
+    return m_peerAddress;
+}
+
+void Ngf::ClientPrivate::setThreadedDispatch(bool enabled)
+{
+    // Takes effect in connect()
+    m_threadedDispatch = enabled;
+}
+
+bool Ngf::ClientPrivate::isThreadedDispatch() const
+{
+    return m_threadedDispatch;
+}
+
+int Ngf::ClientPrivate::state(quint32 eventId)
+{
+    int state;
+
+    if (callInDispatchThread("state", Q_RETURN_ARG(int, state), Q_ARG(quint32, eventId)))
+        return state;
+
+    // The event table is only touched in the thread events are dispatched in
+    Q_ASSERT(isOwnerThread());
+
+    // The event may still be waiting in the queue if it was played from another thread
+    drainRequests();
+
+    return eventState(m_events.byClientId(eventId));
+}
+
+int Ngf::ClientPrivate::state(quint32 clientEventId, const EventRef &ref)
+{
+    // Off the owner thread the event is looked up there by identifier, which needs a
+    // dispatch thread to ask. Without one the client thread alone knows the state.
+    if (!isOwnerThread())
+        return m_dispatchThread ? state(clientEventId) : int(Client::EventUnknown);
+
+    if (ref.slot < 0)
+        return state(clientEventId);
+
+    return eventState(m_events.resolve(ref));
+}
+
+int Ngf::ClientPrivate::eventState(const Event *event) const
+{
+    if (!event)
+        return Client::EventUnknown;
+
+    // Stop requested before the event started waits for it in pendingState
+    if (event->wantedState == StateStopped || event->pendingState == StateStopped)
+        return Client::EventStopping;
+
+    switch (event->activeState) {
+    case StateNew:
+        return Client::EventStarting;
+    case StatePaused:
+        return Client::EventPaused;
+    default:
+        return Client::EventPlaying;
+    }
+}
+
+QList<quint32> Ngf::ClientPrivate::activeEvents()
+{
+    QList<quint32> events;
+
+    if (callInDispatchThread("activeEvents", Q_RETURN_ARG(QList<quint32>, events)))
+        return events;
+
+    drainRequests();
+
+    for (int slot = 0; slot < m_events.capacity() && events.count() < m_events.count(); ++slot) {
+        const Event *event = m_events.slotAt(slot);
+
+        if (event && event->wantedState != StateStopped && event->pendingState != StateStopped)
+            events.append(event->clientEventId);
+    }
+
+    return events;
+}
+
+QVariantMap Ngf::ClientPrivate::statistics() const
+{
+    QVariantMap stats;
+
+    if (callInDispatchThread("statistics", Q_RETURN_ARG(QVariantMap, stats)))
+        return stats;
+
+    stats.insert("transport", QString(!m_peerName.isEmpty() ? "peer"
+                                      : !m_busName.isEmpty() ? "private" : "bus"));
+    stats.insert("statusSubscribed", m_subscribed);
+    stats.insert("sharedClients", m_hub ? m_hub->clientCount() : 0);
+    stats.insert("serviceAvailable", !m_hub || m_hub->isServiceAvailable());
+    stats.insert("serviceOwner", m_hub ? m_hub->serviceOwner() : QString());
+    stats.insert("events", m_events.count());
+    stats.insert("eventCapacity", m_events.capacity());
+    stats.insert("eventHighWaterMark", m_events.highWaterMark());
+    stats.insert("eventTableBytes", m_events.memoryUsage());
+    stats.insert("plays", m_playCount);
+    stats.insert("detachedPlays", m_detachedPlayCount);
+    stats.insert("batches", m_batchCount);
+    stats.insert("pendingReplies", m_busReplyCount + m_peerReplyCount);
+    stats.insert("replyReceivers", m_receiverCount);
+    stats.insert("inFlight", inFlight());
+    stats.insert("queueDepth", m_heldPlays.count());
+    stats.insert("rejectedPlays", m_rejectedPlayCount.loadAcquire());
+    stats.insert("droppedPlays", m_droppedPlayCount.loadAcquire());
+    stats.insert("failureCacheEntries", m_failureCache.count());
+    stats.insert("shortCircuitedPlays", m_shortCircuitCount);
+    stats.insert("earlyStatuses", m_earlyStatusCount);
+    stats.insert("replyTimeouts", m_replyTimeoutCount);
+    stats.insert("sweeps", m_sweepCount);
+    stats.insert("sweptEvents", m_sweptEventCount);
+    stats.insert("sweepTime", m_sweepTime);
+    stats.insert("sweepBytes", m_sweepCandidates.capacity() * int(sizeof(SweepCandidate)));
+    stats.insert("recoveries", m_recoveryCount);
+    stats.insert("recoveredEvents", m_recoveredEventCount);
+    stats.insert("outageTime", m_outageTime);
+    stats.insert("recoveryTime", m_recoveryTime);
+    stats.insert("offlinePlays", m_offlinePlayCount);
+    stats.insert("offlineQueueDepth", m_offlinePlays.size());
+    stats.insert("offlineOverflows", m_offlineOverflowCount);
+    stats.insert("offlineExpiredPlays", m_offlineExpiredCount);
+    stats.insert("stateRequests", m_stateRequestCount);
+    stats.insert("elidedStateRequests", m_elidedStateRequestCount);
+    stats.insert("queuedRequests", m_queuedRequestCount);
+    stats.insert("threadedDispatch", m_dispatchThread != 0);
+
+    return stats;
+}
+
+void Ngf::ClientPrivate::removeEvent(Event *event)
+{
+    // Events ending any other way than completing have failed
+    resolveWaiter(event, Client::ResultFailed);
+    if (m_hub && event->serverEventId)
+        m_hub->unclaim(event->serverEventId, m_hubEntry);
+    m_events.remove(event);
+
+    if (m_events.count() == 0)
+        updateSubscription();
+}
+
+void Ngf::ClientPrivate::removeAllEvents()
+{
+    for (int slot = 0; slot < m_events.capacity(); ++slot) {
+        Event *event = m_events.slotAt(slot);
+        if (!event)
+            continue;
+        resolveWaiter(event, Client::ResultFailed);
+        if (m_hub && event->serverEventId)
+            m_hub->unclaim(event->serverEventId, m_hubEntry);
+    }
+
+    m_events.clear();
+    m_deadlines.clear();
+    m_replyTimer.stop();
+    m_sweepTimer.stop();
+
+    // Late replies are from a daemon which took its events with it
+    m_expiredPlays.clear();
+    m_earlyStatuses.clear();
+    m_heldEvents.clear();
+    updateSubscription();
+}
+
+void Ngf::ClientPrivate::holdEvents()
+{
+    m_heldEvents.clear();
+
+    // Events the daemon had running and which aren't on their way out are played again
+    // in their wanted state, everything else goes like when not recovering.
+    for (int slot = 0; slot < m_events.capacity(); ++slot) {
+        Event *event = m_events.slotAt(slot);
+
+        if (!event)
+            continue;
+
+        if (!event->serverEventId || event->wantedState == StateStopped
+                || !event->recoverable) {
+            removeEvent(event);
+            continue;
+        }
+
+        if (m_hub)
+            m_hub->unclaim(event->serverEventId, m_hubEntry);
+        m_events.setServerId(event, 0);
+
+        event->pendingState = event->wantedState == StatePaused ? StatePaused : StateNew;
+        event->wantedState = StatePlaying;
+        event->requestedState = StatePlaying;
+        event->activeState = StateNew;
+        event->stateQueued = false;
+
+        m_heldEvents.append(m_events.ref(event));
+    }
+
+    // Queued requests, deadlines and late replies are for events of the daemon which
+    // went away
+    m_stateQueue.clear();
+    m_flushTimer.stop();
+    m_deadlines.clear();
+    m_replyTimer.stop();
+    m_expiredPlays.clear();
+    m_earlyStatuses.clear();
+
+    qCDebug(m_log) << "holding" << m_heldEvents.size() << "events until NGF daemon is back";
+}
+
+void Ngf::ClientPrivate::replayEvents()
+{
+    QVector<EventRef> held;
+    int pending = 0;
+
+    held.swap(m_heldEvents);
+    m_replayStart = m_clock.elapsed();
+    m_replayBatchId = RecoveryBatchIds + quint32(m_recoveryCount % RecoveryBatchIds);
+
+    // All plays are sent before any of the replies is handled, like in a batch
+    for (int i = 0; i < held.size(); ++i) {
+        Event *event = m_events.resolve(held.at(i));
+
+        if (!event)
+            continue;
+
+        // Stopped while NGF daemon was away
+        if (event->pendingState == StateStopped) {
+            const quint32 clientEventId = event->clientEventId;
+            resolveWaiter(event, Client::ResultCompleted);
+            removeEvent(event);
+            emit eventCompleted(clientEventId);
+            continue;
+        }
+
+        ++m_recoveredEventCount;
+        ++pending;
+        sendPlay(event, event->playCall, m_replayBatchId, UseReplyTimeout);
+    }
+
+    qCDebug(m_log) << "replayed" << pending << "events";
+
+    if (pending > 0)
+        m_batchPending.insert(m_replayBatchId, pending);
+    else
+        m_replayStart = -1;
+}
+
+bool Ngf::ClientPrivate::isOffline() const
+{
+    // Only the system bus tells whether NGF daemon is there
+    return m_maxOfflinePlays > 0 && m_hub && !m_hub->isServiceAvailable();
+}
+
+void Ngf::ClientPrivate::startOfflineTimer()
+{
+    qint64 first = -1;
+
+    for (int i = 0; i < m_offlinePlays.size(); ++i) {
+        const qint64 deadline = m_offlinePlays.at(i).deadline;
+        if (deadline >= 0 && (first < 0 || deadline < first))
+            first = deadline;
+    }
+
+    if (first < 0)
+        m_offlineTimer.stop();
+    else
+        m_offlineTimer.start(int(qMax<qint64>(0, first - m_clock.elapsed())));
+}
+
+void Ngf::ClientPrivate::expireOfflinePlays()
+{
+    const qint64 now = m_clock.elapsed();
+    QQueue<HeldPlay> waiting;
+
+    // The queue is short, so all of it is checked, deadlines may be out of order after
+    // the timeout has been changed
+    waiting.swap(m_offlinePlays);
+
+    while (!waiting.isEmpty()) {
+        const HeldPlay held = waiting.dequeue();
+
+        if (held.deadline < 0 || held.deadline > now) {
+            m_offlinePlays.enqueue(held);
+            continue;
+        }
+
+        Event *event = m_events.resolve(held.event);
+
+        if (event) {
+            const quint32 clientEventId = event->clientEventId;
+            ++m_offlineExpiredCount;
+            removeEvent(event);
+            qCWarning(m_log) << clientEventId << "play: NGF daemon didn't appear in time";
+            emit eventFailed(clientEventId);
+        }
+
+        if (held.batchId)
+            batchCallFinished(held.batchId);
+    }
+
+    startOfflineTimer();
+}
+
+void Ngf::ClientPrivate::flushOfflinePlays()
+{
+    QQueue<HeldPlay> waiting;
+    int sent = 0;
+
+    waiting.swap(m_offlinePlays);
+    m_offlineTimer.stop();
+
+    // Everything waiting goes out in one burst, before any of the replies is handled
+    while (!waiting.isEmpty()) {
+        const HeldPlay held = waiting.dequeue();
+        Event *event = m_events.resolve(held.event);
+
+        if (event && event->pendingState == StateStopped) {
+            // Stopped while waiting
+            const quint32 clientEventId = event->clientEventId;
+            resolveWaiter(event, Client::ResultCompleted);
+            removeEvent(event);
+            emit eventCompleted(clientEventId);
+            event = 0;
+        }
+
+        if (!event) {
+            if (held.batchId)
+                batchCallFinished(held.batchId);
+            continue;
+        }
+
+        ++sent;
+        sendPlay(event, held.message, held.batchId, held.replyTimeout);
+    }
+
+    if (sent > 0)
+        qCDebug(m_log) << "sent" << sent << "plays which waited for NGF daemon";
+}
+
+void Ngf::ClientPrivate::updateSubscription()
+{
+    // NGF daemon broadcasts Status of every event it plays. Match only signals sent by
+    // the daemon, and when not subscribed while idle, only while there are events to
+    // follow, so other clients playing events don't wake this process up. On the bus
+    // the match rule is shared with the other clients of the thread.
+    const bool subscribe = m_started && (m_hub || !m_peerName.isEmpty())
+                           && (m_subscribedWhenIdle || m_events.count() > 0);
+
+    if (subscribe == m_subscribed)
+        return;
+
+    if (subscribe) {
+        // Peer connections have no bus names, everything on them comes from the daemon
+        if (m_hub)
+            m_subscribed = m_hub->subscribe(m_hubEntry);
+        else
+            m_subscribed = m_connection.connect(QString(), NgfPath, NgfInterface, SignalStatus,
+                                                this, SLOT(setEventState(quint32,quint32)));
+        if (!m_subscribed)
+            qCWarning(m_log) << "Failed to subscribe to NGF daemon status signals";
+    } else {
+        unsubscribe();
+    }
+
+    qCDebug(m_log) << "status subscription" << m_subscribed;
+}
+
+void Ngf::ClientPrivate::unsubscribe()
+{
+    if (!m_subscribed)
+        return;
+
+    if (m_hub)
+        m_hub->unsubscribe(m_hubEntry);
+    else
+        m_connection.disconnect(QString(), NgfPath, NgfInterface, SignalStatus,
+                                this, SLOT(setEventState(quint32,quint32)));
+    m_subscribed = false;
+}
+
+bool Ngf::ClientPrivate::changeState(quint32 clientEventId, EventState wantedState)
+{
+    if (!isOwnerThread()) {
+        Request *request = new Request(Request::StateById);
+        request->clientEventId = clientEventId;
+        request->state = wantedState;
+        enqueue(request);
+        return true;
+    }
+
+    // The event may still be waiting in the queue if it was played from another thread
+    drainRequests();
+
+    Event *e = m_events.byClientId(clientEventId);
+
+    if (e)
+        requestEventState(e, wantedState);
+
+    return true;
+}
+
+bool Ngf::ClientPrivate::changeState(quint32 clientEventId, const EventRef &ref,
+                                     EventState wantedState)
+{
+    if (ref.slot < 0 || !isOwnerThread())
+        return changeState(clientEventId, wantedState);
+
+    // Handles are made on the owner thread after the event is in the table, so there is
+    // nothing to drain. Events which have ended have a new generation in their slot.
+    Event *e = m_events.resolve(ref);
+
+    if (e)
+        requestEventState(e, wantedState);
+
+    return true;
+}
+
+bool Ngf::ClientPrivate::changeState(const QString &clientEventName, EventState wantedState)
+{
+    if (!isOwnerThread()) {
+        Request *request = new Request(Request::StateByName);
+        request->name = clientEventName;
+        request->state = wantedState;
+        enqueue(request);
+        return true;
+    }
+
+    drainRequests();
+
+    Event *e = m_events.firstByName(clientEventName);
+
+    if (e)
+        requestEventState(e, wantedState);
+
+    return true;
+}
+
+bool Ngf::ClientPrivate::isOwnerThread() const
+{
+    return QThread::currentThread() == thread();
+}
+
+void Ngf::ClientPrivate::startDispatchThread()
+{
+    // Replies and Status signals are delivered to the thread the client private lives in,
+    // so moving it keeps D-Bus traffic going while the client thread is busy.
+    m_dispatchThread = new QThread;
+    m_dispatchThread->setObjectName("ngf-client");
+
+    // Hubs are per thread, a client connected before joins the one of the dispatch thread
+    leaveHub();
+    setParent(0);
+    moveToThread(m_dispatchThread);
+    m_dispatchThread->start();
+
+    qCDebug(m_log) << "dispatching in a thread of its own";
+}
+
+void Ngf::ClientPrivate::stopDispatchThread()
+{
+    if (!m_dispatchThread)
+        return;
+
+    QMetaObject::invokeMethod(this, "returnToClientThread", Qt::BlockingQueuedConnection);
+
+    m_dispatchThread->quit();
+    m_dispatchThread->wait();
+    delete m_dispatchThread;
+    m_dispatchThread = 0;
+}
+
+void Ngf::ClientPrivate::returnToClientThread()
+{
+    m_flushTimer.stop();
+    m_replyTimer.stop();
+    m_sweepTimer.stop();
+    m_offlineTimer.stop();
+    leaveHub();
+    moveToThread(q_ptr->thread());
+}
+
+bool Ngf::ClientPrivate::callInDispatchThread(const char *method, QGenericReturnArgument ret,
+                                              QGenericArgument arg) const
+{
+    // Calls made to a dispatch thread from other threads wait for it to carry them out
+    if (!m_dispatchThread || isOwnerThread())
+        return false;
+
+    QMetaObject::invokeMethod(const_cast<ClientPrivate *>(this), method,
+                              Qt::BlockingQueuedConnection, ret, arg);
+    return true;
+}
+
+void Ngf::ClientPrivate::enqueue(Request *request)
+{
+    // Only the request making the queue non-empty needs to wake up the client thread
+    if (m_requests.push(request))
+        QMetaObject::invokeMethod(this, "drainRequests", Qt::QueuedConnection);
+}
+
+void Ngf::ClientPrivate::drainRequests()
+{
+    Request *request = m_requests.takeAll();
+
+    while (request) {
+        Event *event = 0;
+
+        switch (request->type) {
+        case Request::Play:
+            startEvent(request->name, request->message, request->clientEventId,
+                       request->replyTimeout, request->propertyHash);
+            break;
+        case Request::PlayDetached:
+            sendDetached(request->message);
+            break;
+        case Request::StateById:
+            event = m_events.byClientId(request->clientEventId);
+            break;
+        case Request::StateByName:
+            event = m_events.firstByName(request->name);
+            break;
+        case Request::Await:
+            attachWaiter(request->clientEventId, request->waiter);
+            break;
+        }
+
+        if (event)
+            requestEventState(event, request->state);
+
+        Request *next = request->next;
+        delete request;
+        request = next;
+        ++m_queuedRequestCount;
+    }
+}
+
+void Ngf::ClientPrivate::requestEventState(Event *event, EventState wantedState)
+{
+    if (event->wantedState == wantedState
+            || event->wantedState == StateStopped
+            || event->activeState == StateStopped) {
+        return;
+    } else if (event->activeState == StateNew) {
+        // can't make further requests before we have an id from play()
+        event->pendingState = wantedState;
+        return;
+    }
+
+    event->wantedState = wantedState;
+    qCDebug(m_log) << event->clientEventId << "set state" << event->wantedState;
+
+    // Only the last wanted state is sent when the queue is flushed, so a request
+    // replacing one which hasn't been sent yet is elided.
+    if (event->stateQueued) {
+        ++m_elidedStateRequestCount;
+        return;
+    }
+
+    event->stateQueued = true;
+    m_stateQueue.append(m_events.ref(event));
+
+    if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void Ngf::ClientPrivate::flushStateRequests()
+{
+    QVector<EventRef> queue;
+
+    m_flushTimer.stop();
+    checkPeer();
+    queue.swap(m_stateQueue);
+
+    for (int i = 0; i < queue.size(); ++i) {
+        Event *event = m_events.resolve(queue.at(i));
+
+        if (!event)
+            continue;
+
+        event->stateQueued = false;
+
+        if (event->wantedState == event->requestedState) {
+            // Wanted state went back to what was last requested, e.g. pause and resume
+            ++m_elidedStateRequestCount;
+            continue;
+        }
+
+        sendEventState(event);
+    }
+}
+
+void Ngf::ClientPrivate::sendEventState(Event *event)
+{
+    event->requestedState = event->wantedState;
+    ++m_stateRequestCount;
 
     switch (event->wantedState) {
     case StatePlaying: {
-        QDBusMessage pause = createMethodCall(MethodPause);
+        QDBusMessage pause = createCall(MethodPause);
         pause << event->serverEventId << QVariant(false);
 
-        QDBusConnection::systemBus().asyncCall(pause);
+        sendRequest(pause);
         break;
     }
     case StatePaused: {
-        QDBusMessage pause = createMethodCall(MethodPause);
+        QDBusMessage pause = createCall(MethodPause);
         pause << event->serverEventId << QVariant(true);
 
-        QDBusConnection::systemBus().asyncCall(pause);
+        sendRequest(pause);
         break;
     }
     case StateStopped: {
-        QDBusMessage stop = createMethodCall(MethodStop);
+        QDBusMessage stop = createCall(MethodStop);
         stop << event->serverEventId;
 
-        QDBusConnection::systemBus().asyncCall(stop);
+        sendRequest(stop);
         break;
     }
     case StateNew:
@@ -370,6 +2284,6 @@ void Ngf::ClientPrivate::changeConnected(bool connected)
 {
     if (m_connected != connected) {
         m_connected = connected;
-        emit q_ptr->connectionStatus(m_connected);
+        emit connectionStatus(m_connected);
     }
 }
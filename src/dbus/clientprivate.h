@@ -22,55 +22,241 @@
 #define NGFCLIENTDBUSPRIVATE_H
 
 #include <QObject>
+#include <QAtomicInteger>
 #include <QDBusConnection>
-#include <QDBusPendingCallWatcher>
-#include <QDBusServiceWatcher>
-#include <QList>
+#include <QDBusMessage>
+#include <QElapsedTimer>
+#include <QFutureInterface>
 #include <QLoggingCategory>
+#include <QMutex>
+#include <QQueue>
+#include <QSet>
+#include <QTimer>
 #include "ngfclient.h"
+#include "eventtable.h"
+#include "failurecache.h"
+#include "ratelimiter.h"
+#include "requestqueue.h"
+#include "statushub.h"
 
 namespace Ngf
 {
-    class Event;
-
     typedef QMap<QString, QVariant> Proplist;
 
+    class PreparedEventData : public QSharedData
+    {
+    public:
+        QString event;
+        Proplist properties;
+        QDBusMessage message;   // Play method call, addressed to the daemon owner last known
+        uint propertyHash;
+        QMutex mutex;           // Guards message, prepared events are played from any thread
+    };
+
+    // Future of playAsync(), finished when its event ends
+    class EventWaiter
+    {
+    public:
+        QFutureInterface<Client::EventResult> future;
+    };
+
+    class ClientPrivate;
+
+    /*
+     * Receiver of the reply to one call, knows what the call was for whatever order replies
+     * arrive in. Receivers are pooled by the client and reused once their reply is in.
+     */
+    class ReplyReceiver : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        explicit ReplyReceiver(ClientPrivate *client);
+
+        PendingReply pending;
+
+    private slots:
+        void replied(const QDBusMessage &reply);
+        void failed(const QDBusError &error);
+        void notSent();
+
+    private:
+        ClientPrivate * const m_client;
+    };
+
     class ClientPrivate : public QObject
     {
         Q_OBJECT
+        friend class StatusHub;
+        friend class ReplyReceiver;
 
     public:
         ClientPrivate(Client *parent);
         virtual ~ClientPrivate();
 
-        bool connect();
-        bool isConnected();
-        void disconnect();
+        Q_INVOKABLE bool connect();
+        Q_INVOKABLE bool isConnected();
+        Q_INVOKABLE void disconnect();
         quint32 play(const QString &event);
         quint32 play(const QString &event, const Proplist &properties);
+        quint32 play(const QString &event, const Proplist &properties, int replyTimeout);
+        PreparedEvent prepare(const QString &event, const Proplist &properties) const;
+        quint32 play(const PreparedEvent &event);
+        quint32 play(const PreparedEvent &event, int replyTimeout);
+        EventHandle playHandle(const QString &event, const Proplist &properties);
+        EventHandle playHandle(const PreparedEvent &event);
+        QFuture<Client::EventResult> playAsync(const QString &event, const Proplist &properties);
+        QFuture<Client::EventResult> playAsync(const PreparedEvent &event);
+        bool playDetached(const QString &event, const Proplist &properties);
+        bool playDetached(const PreparedEvent &event);
         bool pause(quint32 eventId);
         bool pause(const QString &event);
         bool resume(quint32 eventId);
         bool resume(const QString &event);
         bool stop(quint32 eventId);
         bool stop(const QString &event);
+        Q_INVOKABLE int state(quint32 eventId);
+        int state(quint32 clientEventId, const EventRef &ref);
+        bool changeState(quint32 clientEventId, const EventRef &ref, EventState wantedState);
+        Q_INVOKABLE QList<quint32> activeEvents();
+        Q_INVOKABLE quint32 beginBatch();
+        Q_INVOKABLE QList<quint32> commitBatch();
+        Q_INVOKABLE void setCoalescingInterval(int msec);
+        Q_INVOKABLE int coalescingInterval() const;
+        Q_INVOKABLE void setReplyTimeout(int msec);
+        Q_INVOKABLE int replyTimeout() const;
+        Q_INVOKABLE void setMaxInFlight(int requests);
+        Q_INVOKABLE int maxInFlight() const;
+        Q_INVOKABLE void setOverflowPolicy(int policy);
+        Q_INVOKABLE int overflowPolicy() const;
+        Q_INVOKABLE void setStaleEventTimeout(int msec);
+        Q_INVOKABLE int staleEventTimeout() const;
+        Q_INVOKABLE void setMaxEvents(int events);
+        Q_INVOKABLE int maxEvents() const;
+        Q_INVOKABLE void setRecoveryEnabled(bool enabled);
+        Q_INVOKABLE bool isRecoveryEnabled() const;
+        Q_INVOKABLE void setMaxOfflinePlays(int plays);
+        Q_INVOKABLE int maxOfflinePlays() const;
+        Q_INVOKABLE void setOfflineTimeout(int msec);
+        Q_INVOKABLE int offlineTimeout() const;
+        void setRateLimit(const QString &event, qreal rate, int burst);
+        Q_INVOKABLE void setSubscribedWhenIdle(bool subscribed);
+        Q_INVOKABLE bool isSubscribedWhenIdle() const;
+        Q_INVOKABLE void setEagerOwnerLookup(bool eager);
+        Q_INVOKABLE bool isEagerOwnerLookup() const;
+        Q_INVOKABLE void setPrivateConnection(bool enabled);
+        Q_INVOKABLE bool isPrivateConnection() const;
+        Q_INVOKABLE void setPeerAddress(const QString &address);
+        Q_INVOKABLE QString peerAddress() const;
+        void setThreadedDispatch(bool enabled);
+        bool isThreadedDispatch() const;
+        Q_INVOKABLE QVariantMap statistics() const;
 
-        enum EventState {
-            StateNew,
-            StatePlaying,
-            StatePaused,
-            StateStopped
-        };
+    signals:
+        // Forwarded to the Client signals, queued to the client thread if dispatching
+        // happens in a thread of its own
+        void connectionStatus(bool connected);
+        void eventFailed(quint32 eventId);
+        void eventCompleted(quint32 eventId);
+        void eventPlaying(quint32 eventId);
+        void eventPaused(quint32 eventId);
+        void batchFinished(quint32 batchId);
+        void congested();
+        void drained();
+        void eventDropped(const QString &event);
 
     private slots:
-        void playPendingReply(QDBusPendingCallWatcher *watcher);
+        void expireReplies();
+        void expireOfflinePlays();
+        void sweepEvents();
+        void reportCachedFailures();
         void setEventState(quint32 serverEventId, quint32 state);
+        void serviceRegistered(const QString &service);
         void serviceUnregistered(const QString &service);
+        void serviceOwnerChanged();
+        void flushStateRequests();
+        void drainRequests();
+        void returnToClientThread();
 
     private:
+        // Request collected while a batch is open, event is set for play requests only
+        struct BatchCall {
+            QDBusMessage message;
+            EventRef event;
+            int replyTimeout;
+        };
+
+        // Event considered for reclaiming by the sweeper
+        struct SweepCandidate {
+            qint64 lastSeen;
+            EventRef event;
+
+            bool operator<(const SweepCandidate &other) const { return lastSeen < other.lastSeen; }
+        };
+
+        // Play held back by the in-flight limit
+        struct HeldPlay {
+            QDBusMessage message;
+            EventRef event;
+            quint32 batchId;
+            int replyTimeout;
+            qint64 deadline;    // [ms] Waiting for NGF daemon fails after this, -1 for never
+        };
+
+        quint32 playMessage(const QString &event, const QDBusMessage &play, int replyTimeout,
+                            uint propertyHash);
+        void startEvent(const QString &event, const QDBusMessage &play, quint32 clientEventId,
+                        int replyTimeout, uint propertyHash);
+        EventHandle handle(quint32 clientEventId);
+        QFuture<Client::EventResult> await(quint32 clientEventId);
+        void attachWaiter(quint32 clientEventId, EventWaiter *waiter);
+        void finishWaiter(EventWaiter *waiter, Client::EventResult result);
+        void resolveWaiter(Event *event, Client::EventResult result);
+        int eventState(const Event *event) const;
+        bool isOwnerThread() const;
+        void startDispatchThread();
+        void stopDispatchThread();
+        bool callInDispatchThread(const char *method,
+                                  QGenericReturnArgument ret = QGenericReturnArgument(),
+                                  QGenericArgument arg = QGenericArgument()) const;
+        void enqueue(Request *request);
+        void sendPlay(Event *event, const QDBusMessage &play, quint32 batchId, int replyTimeout);
+        void callPlay(Event *event, const QDBusMessage &play, quint32 batchId, int replyTimeout);
+        int inFlight() const;
+        void releaseHeldPlays();
+        void updateCongestion();
+        void sendCall(const QDBusMessage &call, const PendingReply &pending);
+        bool admit(const QString &event);
+        bool sendDetached(const QDBusMessage &play);
+        void sendRequest(const QDBusMessage &request);
+        QDBusMessage createCall(const QString &method) const;
+        QDBusMessage addressed(const QDBusMessage &call) const;
+        QDBusMessage preparedPlay(PreparedEventData *data) const;
+        void callFinished(ReplyReceiver *receiver, const QDBusMessage &reply);
+        void finishCall(const PendingReply &pending, const QDBusMessage &reply);
+        void finishPlay(const EventRef &ref, const QDBusMessage &reply);
+        void noteFailure(const Event *event);
+        void stopExpiredPlay(const PendingReply &pending, const QDBusMessage &reply);
+        void startReplyTimer();
+        void startSweepTimer();
+        void stopServerEvent(quint32 serverEventId);
+        void batchCallFinished(quint32 batchId);
         void requestEventState(Event *event, EventState wantedState);
+        void sendEventState(Event *event);
         void removeEvent(Event *event);
         void removeAllEvents();
+        void holdEvents();
+        void replayEvents();
+        bool isOffline() const;
+        void startOfflineTimer();
+        void flushOfflinePlays();
+        void updateSubscription();
+        void unsubscribe();
+        void openConnection();
+        void useSystemBus();
+        void joinHub();
+        void leaveHub();
+        void checkPeer();
         bool changeState(quint32 clientEventId, EventState wantedState);
         bool changeState(const QString &clientEventName, EventState wantedState);
         void changeConnected(bool connected);
@@ -79,10 +265,83 @@ namespace Ngf
         Q_DECLARE_PUBLIC(Client)
 
         QLoggingCategory m_log;
-        QDBusServiceWatcher *m_serviceWatcher;
+        QDBusConnection m_connection;   // Connection used for talking to NGF daemon
+        QString m_peerAddress;
+        QString m_peerName;             // Name of the peer connection if one is in use
+        bool m_privateConnection;       // Use a system bus connection of its own
+        QString m_busName;              // Name of the private bus connection if one is open
+        bool m_started;                 // Connection has been opened by connect()
+        StatusHub *m_hub;               // Shared Status subscription while on the system bus
+        int m_hubEntry;
+        bool m_eagerOwnerLookup;        // Look up the daemon unique name in connect()
         bool m_connected;
-        quint32 m_clientEventId; // Internal counter for client event ids, incremented every time play is called.
-        QList<Event*> m_events;
+        bool m_subscribed;          // Receiving Status signals from NGF daemon
+        bool m_subscribedWhenIdle;
+        QAtomicInteger<quint32> m_clientEventId; // Internal counter for client event ids, incremented every time play is called.
+        EventTable m_events;
+        int m_busReplyCount;            // Calls waiting for a reply on each connection
+        int m_peerReplyCount;
+        int m_busPlayCount;             // Plays among them, the ones in flight
+        int m_peerPlayCount;
+        QVector<ReplyReceiver *> m_freeReceivers;
+        int m_receiverCount;            // Receivers created, free or waiting for a reply
+        quint64 m_playCount;
+        quint64 m_detachedPlayCount;
+        quint32 m_batchId;      // Open batch, or the last committed one if m_batchDepth is 0
+        int m_batchDepth;
+        QVector<BatchCall> m_batchCalls;
+        QHash<quint32, int> m_batchPending;     // Replies still expected per committed batch
+        quint64 m_batchCount;
+        QTimer m_flushTimer;
+        QVector<EventRef> m_stateQueue;     // Events with a wanted state not yet sent
+        quint64 m_stateRequestCount;
+        quint64 m_elidedStateRequestCount;
+        QTimer m_replyTimer;                // Fires at the earliest reply deadline
+        QElapsedTimer m_clock;
+        DeadlineQueue m_deadlines;
+        QSet<quint32> m_expiredPlays;       // Plays given up on, still waiting for a reply
+        int m_replyTimeout;                 // [ms] 0 waits as long as D-Bus does
+        quint64 m_replyTimeoutCount;
+        int m_maxInFlight;                  // 0 for no limit
+        Client::OverflowPolicy m_overflowPolicy;
+        QQueue<HeldPlay> m_heldPlays;
+        bool m_congested;
+        QAtomicInt m_rejecting;             // Congested and refusing plays, read from any thread
+        QAtomicInt m_rejectedPlayCount;
+        RateLimiter m_rateLimiter;
+        QAtomicInt m_droppedPlayCount;
+        FailureCache m_failureCache;
+        QVector<quint32> m_cachedFailures;  // Plays failed by the cache, not yet reported
+        quint64 m_shortCircuitCount;
+        StatusBuffer m_earlyStatuses;       // Statuses of events whose Play reply is pending
+        quint64 m_earlyStatusCount;
+        QTimer m_sweepTimer;                // Reclaims events NGF daemon has gone quiet about
+        int m_staleEventTimeout;            // [ms] 0 keeps events as long as they are playing
+        int m_maxEvents;                    // 0 for no limit
+        QVector<SweepCandidate> m_sweepCandidates;  // Kept to sweep without allocating
+        quint64 m_sweepCount;
+        quint64 m_sweptEventCount;
+        qint64 m_sweepTime;                 // [us] Spent sweeping in total
+        bool m_recoveryEnabled;
+        QVector<EventRef> m_heldEvents;     // Events to play again once NGF daemon is back
+        qint64 m_outageStart;               // [ms] Client clock time NGF daemon went away, -1 if up
+        qint64 m_replayStart;               // [ms] Client clock time events were played again
+        quint32 m_replayBatchId;            // Batch of the last replay, 0 before any
+        quint64 m_recoveryCount;
+        quint64 m_recoveredEventCount;
+        qint64 m_outageTime;                // [ms] Length of the last outage
+        qint64 m_recoveryTime;              // [ms] Replies to the last replay took this long
+        int m_maxOfflinePlays;              // 0 to send plays even if NGF daemon is missing
+        int m_offlineTimeout;               // [ms] 0 to wait for NGF daemon indefinitely
+        QQueue<HeldPlay> m_offlinePlays;    // Plays waiting for NGF daemon to take its name
+        QTimer m_offlineTimer;
+        quint64 m_offlinePlayCount;
+        quint64 m_offlineOverflowCount;
+        quint64 m_offlineExpiredCount;
+        RequestQueue m_requests;            // Requests made from other threads
+        quint64 m_queuedRequestCount;
+        bool m_threadedDispatch;
+        QThread *m_dispatchThread;          // Thread of its own, if dispatching is threaded
     };
 }
 
@@ -3,9 +3,19 @@ INCLUDEPATH += ./dbus
 HEADERS += \
     include/ngfclient.h \
     include/ngfclient_global.h \
-    dbus/clientprivate.h
+    dbus/clientprivate.h \
+    dbus/eventtable.h \
+    dbus/failurecache.h \
+    dbus/ratelimiter.h \
+    dbus/requestqueue.h \
+    dbus/statushub.h
 
 SOURCES += \
     dbus/client.cpp \
-    dbus/clientprivate.cpp
+    dbus/clientprivate.cpp \
+    dbus/eventtable.cpp \
+    dbus/failurecache.cpp \
+    dbus/ratelimiter.cpp \
+    dbus/requestqueue.cpp \
+    dbus/statushub.cpp
 
@@ -0,0 +1,524 @@
+/*
+ * NgfClient - Qt Non-Graphic Feedback daemon client library
+ *
+ * Copyright (C) 2026 Jolla Ltd.
+ * Contact: juho.hamalainen@jolla.com
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "eventtable.h"
+
+Ngf::Event::Event()
+    : clientEventId(0), serverEventId(0),
+      wantedState(StatePlaying),
+      activeState(StateNew),
+      pendingState(StateNew),
+      requestedState(StatePlaying),
+      stateQueued(false),
+      recoverable(false),
+      propertyHash(0),
+      playTime(0),
+      lastSeen(0),
+      waiter(0),
+      slot(-1), generation(0),
+      namePrev(-1), nameNext(-1),
+      nextFree(-1),
+      used(false)
+{
+}
+
+void Ngf::DeadlineQueue::insert(qint64 deadline, const EventRef &event)
+{
+    Deadline item;
+    item.time = deadline;
+    item.event = event;
+
+    // Sift up from the new leaf
+    int i = m_heap.size();
+    m_heap.append(item);
+
+    while (i > 0) {
+        const int parent = (i - 1) / 2;
+        if (m_heap.at(parent).time <= deadline)
+            break;
+        m_heap[i] = m_heap.at(parent);
+        i = parent;
+    }
+
+    m_heap[i] = item;
+}
+
+qint64 Ngf::DeadlineQueue::first() const
+{
+    return m_heap.first().time;
+}
+
+Ngf::EventRef Ngf::DeadlineQueue::takeFirst()
+{
+    const EventRef event = m_heap.first().event;
+    const Deadline last = m_heap.last();
+
+    // Removing the last item keeps the capacity, so the heap only ever grows
+    m_heap.removeLast();
+
+    const int count = m_heap.size();
+    int i = 0;
+
+    // Sift the last item down from the root
+    while (count > 0) {
+        int child = 2 * i + 1;
+        if (child >= count)
+            break;
+        if (child + 1 < count && m_heap.at(child + 1).time < m_heap.at(child).time)
+            ++child;
+        if (last.time <= m_heap.at(child).time)
+            break;
+        m_heap[i] = m_heap.at(child);
+        i = child;
+    }
+
+    if (count > 0)
+        m_heap[i] = last;
+
+    return event;
+}
+
+bool Ngf::DeadlineQueue::isEmpty() const
+{
+    return m_heap.isEmpty();
+}
+
+void Ngf::DeadlineQueue::clear()
+{
+    m_heap.resize(0);
+}
+
+Ngf::StatusBuffer::StatusBuffer()
+    : m_count(0)
+{
+}
+
+void Ngf::StatusBuffer::insert(quint32 serverEventId, quint32 state)
+{
+    if (m_count == Capacity) {
+        for (int i = 1; i < m_count; ++i)
+            m_items[i - 1] = m_items[i];
+        --m_count;
+    }
+
+    m_items[m_count].serverEventId = serverEventId;
+    m_items[m_count].state = state;
+    ++m_count;
+}
+
+bool Ngf::StatusBuffer::take(quint32 serverEventId, quint32 *state)
+{
+    for (int i = 0; i < m_count; ++i) {
+        if (m_items[i].serverEventId != serverEventId)
+            continue;
+
+        *state = m_items[i].state;
+
+        for (++i; i < m_count; ++i)
+            m_items[i - 1] = m_items[i];
+        --m_count;
+
+        return true;
+    }
+
+    return false;
+}
+
+bool Ngf::StatusBuffer::isEmpty() const
+{
+    return m_count == 0;
+}
+
+int Ngf::StatusBuffer::count() const
+{
+    return m_count;
+}
+
+void Ngf::StatusBuffer::clear()
+{
+    m_count = 0;
+}
+
+Ngf::EventIndex::EventIndex()
+    : m_count(0)
+{
+}
+
+int Ngf::EventIndex::value(quint64 key) const
+{
+    if (m_count == 0)
+        return -1;
+
+    const int mask = m_buckets.size() - 1;
+
+    for (int i = home(key); ; i = (i + 1) & mask) {
+        const Bucket &bucket = m_buckets.at(i);
+        if (bucket.slot < 0)
+            return -1;
+        if (bucket.key == key)
+            return bucket.slot;
+    }
+}
+
+void Ngf::EventIndex::insert(quint64 key, int slot)
+{
+    // Keep at most half of the buckets in use to keep probe sequences short
+    if ((m_count + 1) * 2 > m_buckets.size())
+        rehash(qMax(16, m_buckets.size() * 2));
+
+    const int mask = m_buckets.size() - 1;
+    int i = home(key);
+
+    while (m_buckets.at(i).slot >= 0 && m_buckets.at(i).key != key)
+        i = (i + 1) & mask;
+
+    if (m_buckets.at(i).slot < 0)
+        ++m_count;
+
+    m_buckets[i].key = key;
+    m_buckets[i].slot = slot;
+}
+
+void Ngf::EventIndex::remove(quint64 key)
+{
+    if (m_count == 0)
+        return;
+
+    const int mask = m_buckets.size() - 1;
+    int i = home(key);
+
+    while (m_buckets.at(i).key != key) {
+        if (m_buckets.at(i).slot < 0)
+            return;
+        i = (i + 1) & mask;
+    }
+
+    if (m_buckets.at(i).slot < 0)
+        return;
+
+    // Shift following entries of the probe sequence back instead of leaving
+    // a tombstone, so lookups never have to skip deleted buckets.
+    for (int j = (i + 1) & mask; m_buckets.at(j).slot >= 0; j = (j + 1) & mask) {
+        const int k = home(m_buckets.at(j).key);
+        const bool stays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+        if (!stays) {
+            m_buckets[i] = m_buckets.at(j);
+            i = j;
+        }
+    }
+
+    m_buckets[i].slot = -1;
+    --m_count;
+}
+
+void Ngf::EventIndex::clear()
+{
+    for (int i = 0; i < m_buckets.size(); ++i)
+        m_buckets[i].slot = -1;
+
+    m_count = 0;
+}
+
+int Ngf::EventIndex::memoryUsage() const
+{
+    return m_buckets.capacity() * int(sizeof(Bucket));
+}
+
+int Ngf::EventIndex::home(quint64 key) const
+{
+    // Fibonacci hashing, bucket count is always a power of two
+    const quint64 hash = key * Q_UINT64_C(0x9E3779B97F4A7C15);
+
+    return int(hash >> 32) & (m_buckets.size() - 1);
+}
+
+void Ngf::EventIndex::rehash(int bucketCount)
+{
+    QVector<Bucket> old = m_buckets;
+    Bucket empty = { 0, -1 };
+
+    m_buckets = QVector<Bucket>(bucketCount, empty);
+    m_count = 0;
+
+    for (int i = 0; i < old.size(); ++i) {
+        if (old.at(i).slot >= 0)
+            insert(old.at(i).key, old.at(i).slot);
+    }
+}
+
+Ngf::EventTable::EventTable()
+    : m_firstFree(-1),
+      m_count(0),
+      m_highWaterMark(0),
+      m_idleNames(0)
+{
+}
+
+Ngf::EventTable::~EventTable()
+{
+    for (int i = 0; i < m_chunks.size(); ++i)
+        delete [] m_chunks.at(i);
+}
+
+Ngf::Event *Ngf::EventTable::insert(const QString &name, quint32 clientEventId)
+{
+    if (m_firstFree < 0)
+        grow();
+
+    Event *event = storage(m_firstFree);
+    m_firstFree = event->nextFree;
+
+    event->name = name;
+    event->clientEventId = clientEventId;
+    event->serverEventId = 0;
+    event->wantedState = StatePlaying;
+    event->activeState = StateNew;
+    event->pendingState = StateNew;
+    event->requestedState = StatePlaying;
+    event->stateQueued = false;
+    event->recoverable = false;
+    event->propertyHash = 0;
+    event->playTime = 0;
+    event->lastSeen = 0;
+    event->waiter = 0;
+    event->playCall = QDBusMessage();
+    event->nextFree = -1;
+    event->used = true;
+
+    if (++m_count > m_highWaterMark)
+        m_highWaterMark = m_count;
+
+    m_byClientId.insert(clientEventId, event->slot);
+    linkName(event);
+
+    return event;
+}
+
+void Ngf::EventTable::remove(Event *event)
+{
+    Q_ASSERT(event && event->used);
+
+    m_byClientId.remove(event->clientEventId);
+    if (event->serverEventId)
+        m_byServerId.remove(event->serverEventId);
+    unlinkName(event);
+
+    event->name = QString();
+    event->playCall = QDBusMessage();
+    event->used = false;
+    ++event->generation;
+
+    event->nextFree = m_firstFree;
+    m_firstFree = event->slot;
+    --m_count;
+}
+
+void Ngf::EventTable::clear()
+{
+    m_firstFree = -1;
+
+    // Free slots are handed out from the head of the list, so build it backwards
+    // to reuse the table from the beginning.
+    for (int i = capacity() - 1; i >= 0; --i) {
+        Event *event = storage(i);
+        if (event->used) {
+            event->name = QString();
+            event->playCall = QDBusMessage();
+            event->used = false;
+            ++event->generation;
+        }
+        event->nextFree = m_firstFree;
+        m_firstFree = i;
+    }
+
+    m_count = 0;
+    m_byClientId.clear();
+    m_byServerId.clear();
+    m_byName.clear();
+    m_idleNames = 0;
+}
+
+int Ngf::EventTable::count() const
+{
+    return m_count;
+}
+
+int Ngf::EventTable::capacity() const
+{
+    return m_chunks.size() * ChunkSize;
+}
+
+int Ngf::EventTable::highWaterMark() const
+{
+    return m_highWaterMark;
+}
+
+int Ngf::EventTable::memoryUsage() const
+{
+    return capacity() * int(sizeof(Event))
+            + m_chunks.capacity() * int(sizeof(Event*))
+            + m_byClientId.memoryUsage()
+            + m_byServerId.memoryUsage();
+}
+
+Ngf::Event *Ngf::EventTable::byClientId(quint32 clientEventId)
+{
+    return slotAt(m_byClientId.value(clientEventId));
+}
+
+Ngf::Event *Ngf::EventTable::byServerId(quint32 serverEventId)
+{
+    return slotAt(m_byServerId.value(serverEventId));
+}
+
+Ngf::Event *Ngf::EventTable::firstByName(const QString &name)
+{
+    QHash<QString, NameChain>::const_iterator it = m_byName.constFind(name);
+
+    return it == m_byName.constEnd() ? 0 : slotAt(it.value().first);
+}
+
+Ngf::Event *Ngf::EventTable::setServerId(Event *event, quint32 serverEventId)
+{
+    if (event->serverEventId)
+        m_byServerId.remove(event->serverEventId);
+
+    event->serverEventId = serverEventId;
+
+    if (!serverEventId)
+        return 0;
+
+    // Ids are unique per daemon instance, so a holder is left over from a daemon which
+    // has gone. It is detached, or removing either event would drop the other's entry.
+    Event *holder = byServerId(serverEventId);
+
+    if (holder && holder != event)
+        holder->serverEventId = 0;
+    else
+        holder = 0;
+
+    m_byServerId.insert(serverEventId, event->slot);
+    return holder;
+}
+
+Ngf::EventRef Ngf::EventTable::ref(const Event *event) const
+{
+    EventRef ref = { event->slot, event->generation };
+
+    return ref;
+}
+
+Ngf::Event *Ngf::EventTable::resolve(const EventRef &ref)
+{
+    Event *event = slotAt(ref.slot);
+
+    return event && event->generation == ref.generation ? event : 0;
+}
+
+Ngf::Event *Ngf::EventTable::slotAt(int slot)
+{
+    if (slot < 0 || slot >= capacity())
+        return 0;
+
+    Event *event = storage(slot);
+
+    return event->used ? event : 0;
+}
+
+Ngf::Event *Ngf::EventTable::storage(int slot) const
+{
+    return &m_chunks.at(slot >> ChunkShift)[slot & (ChunkSize - 1)];
+}
+
+void Ngf::EventTable::grow()
+{
+    const int first = capacity();
+    Event *chunk = new Event[ChunkSize];
+
+    m_chunks.append(chunk);
+
+    for (int i = ChunkSize - 1; i >= 0; --i) {
+        chunk[i].slot = first + i;
+        chunk[i].nextFree = m_firstFree;
+        m_firstFree = first + i;
+    }
+}
+
+void Ngf::EventTable::linkName(Event *event)
+{
+    QHash<QString, NameChain>::iterator it = m_byName.find(event->name);
+
+    event->nameNext = -1;
+
+    if (it == m_byName.end()) {
+        NameChain chain = { event->slot, event->slot };
+        event->namePrev = -1;
+        m_byName.insert(event->name, chain);
+    } else if (it->first < 0) {
+        // Reuse the entry of a name which has been played before
+        event->namePrev = -1;
+        it->first = event->slot;
+        it->last = event->slot;
+        --m_idleNames;
+    } else {
+        event->namePrev = it->last;
+        storage(it->last)->nameNext = event->slot;
+        it->last = event->slot;
+    }
+}
+
+void Ngf::EventTable::unlinkName(Event *event)
+{
+    QHash<QString, NameChain>::iterator it = m_byName.find(event->name);
+
+    Q_ASSERT(it != m_byName.end());
+
+    if (event->namePrev >= 0)
+        storage(event->namePrev)->nameNext = event->nameNext;
+    else
+        it->first = event->nameNext;
+
+    if (event->nameNext >= 0)
+        storage(event->nameNext)->namePrev = event->namePrev;
+    else
+        it->last = event->namePrev;
+
+    event->namePrev = -1;
+    event->nameNext = -1;
+
+    // Keep the entry for a while, most clients play the same few events over and
+    // over again and reusing the entry saves allocating it again.
+    if (it->first < 0 && ++m_idleNames > MaxIdleNames)
+        purgeIdleNames();
+}
+
+void Ngf::EventTable::purgeIdleNames()
+{
+    QHash<QString, NameChain>::iterator it = m_byName.begin();
+
+    while (it != m_byName.end()) {
+        if (it->first < 0)
+            it = m_byName.erase(it);
+        else
+            ++it;
+    }
+
+    m_idleNames = 0;
+}
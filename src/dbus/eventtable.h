@@ -0,0 +1,250 @@
+/*
+ * NgfClient - Qt Non-Graphic Feedback daemon client library
+ *
+ * Copyright (C) 2026 Jolla Ltd.
+ * Contact: juho.hamalainen@jolla.com
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef NGFEVENTTABLE_H
+#define NGFEVENTTABLE_H
+
+#include <QDBusMessage>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace Ngf
+{
+    class EventWaiter;
+
+    enum EventState {
+        StateNew,
+        StatePlaying,
+        StatePaused,
+        StateStopped
+    };
+
+    class Event
+    {
+    public:
+        Event();
+
+        QString name;
+        quint32 clientEventId;
+        quint32 serverEventId;
+        EventState wantedState;
+        EventState activeState;
+        EventState pendingState;
+        EventState requestedState;      // Last state requested from NGF daemon
+        bool stateQueued;               // Wanted state waits for the next flush
+        bool recoverable;               // Played while recovery was enabled
+        uint propertyHash;              // Hash of the properties the event was played with
+        qint64 playTime;                // [ms] Client clock time the event was played
+        qint64 lastSeen;                // [ms] Client clock time NGF daemon last told of it
+        EventWaiter *waiter;            // Future waiting for the event to end, owned
+        QDBusMessage playCall;          // Properties for the failure cache, played again if recovering
+
+    private:
+        friend class EventTable;
+
+        int slot;
+        quint32 generation;     // Bumped every time the slot is released
+        int namePrev;           // Neighbours in the chain of events sharing a name, -1 terminated
+        int nameNext;
+        int nextFree;           // Next slot in the free list, -1 terminated
+        bool used;
+    };
+
+    /*
+     * Reference to an event that stays safe to hold while the table changes. Resolving
+     * it gives back the event only if its slot hasn't been released in the meantime.
+     */
+    struct EventRef
+    {
+        int slot;
+        quint32 generation;
+    };
+
+    /*
+     * Call waiting for a reply from NGF daemon. Event is set for Play calls only.
+     */
+    struct PendingReply
+    {
+        EventRef event;
+        quint32 clientEventId;
+        quint32 batchId;    // 0 if the call isn't part of a batch
+        bool peer;          // Sent over a peer connection
+    };
+
+    /*
+     * Events waiting for a reply, ordered by the time they stop waiting.
+     *
+     * Deadlines are kept in a binary heap, so the earliest one is found in constant time
+     * and deadlines are added and taken in logarithmic time. Deadlines aren't removed
+     * when replies arrive, the caller skips events which got their reply as the deadlines
+     * are taken.
+     */
+    class DeadlineQueue
+    {
+    public:
+        void insert(qint64 deadline, const EventRef &event);
+        qint64 first() const;           // Earliest deadline, the queue must not be empty
+        EventRef takeFirst();
+        bool isEmpty() const;
+        void clear();
+
+    private:
+        struct Deadline
+        {
+            qint64 time;
+            EventRef event;
+        };
+
+        QVector<Deadline> m_heap;
+    };
+
+    /*
+     * Status signals received for server event ids not known yet.
+     *
+     * NGF daemon may send the Status of an event before the reply to its Play call reaches
+     * the client. The few statuses in between are kept in a fixed array in the order they
+     * arrived, the oldest one giving way when the array is full.
+     */
+    class StatusBuffer
+    {
+    public:
+        enum { Capacity = 16 };
+
+        StatusBuffer();
+
+        void insert(quint32 serverEventId, quint32 state);
+        bool take(quint32 serverEventId, quint32 *state);  // Oldest status of the event first
+        bool isEmpty() const;
+        int count() const;
+        void clear();
+
+    private:
+        struct Status
+        {
+            quint32 serverEventId;
+            quint32 state;
+        };
+
+        Status m_items[Capacity];
+        int m_count;
+    };
+
+    /*
+     * Open addressing map from an integer key to an event slot.
+     *
+     * Buckets are kept in one array which only grows when the number of keys does,
+     * so inserting and removing keys in a steady state doesn't allocate.
+     */
+    class EventIndex
+    {
+    public:
+        EventIndex();
+
+        int value(quint64 key) const;   // -1 if key is not found
+        void insert(quint64 key, int slot);
+        void remove(quint64 key);
+        void clear();
+
+        int memoryUsage() const;
+
+    private:
+        struct Bucket {
+            quint64 key;
+            int slot;                   // -1 for an empty bucket
+        };
+
+        int home(quint64 key) const;
+        void rehash(int bucketCount);
+
+        QVector<Bucket> m_buckets;
+        int m_count;
+    };
+
+    /*
+     * Table of the events a client is tracking.
+     *
+     * Events are stored in slots of fixed size chunks which are never moved or freed
+     * while the table exists. Released slots go to a free list and are reused, so once
+     * the table has grown to its high-water mark, playing and completing events doesn't
+     * allocate. Events can be found by client id, server id or name through indexes, so
+     * neither lookups nor removals depend on the number of events.
+     *
+     * Use EventRef to hold on to an event across anything that may call back into the
+     * client (signal emission), the slot may have been released and reused meanwhile.
+     */
+    class EventTable
+    {
+    public:
+        EventTable();
+        ~EventTable();
+
+        Event *insert(const QString &name, quint32 clientEventId);
+        void remove(Event *event);
+        void clear();
+
+        int count() const;
+        int capacity() const;
+        int highWaterMark() const;      // Most events tracked at the same time
+        int memoryUsage() const;        // Bytes used by the slots and indexes
+
+        Event *byClientId(quint32 clientEventId);
+        Event *byServerId(quint32 serverEventId);
+        Event *firstByName(const QString &name);    // Oldest event with the name
+        Event *slotAt(int slot);        // 0 if the slot is free, slots run up to capacity()
+
+        // An event already holding the id loses it, and is returned
+        Event *setServerId(Event *event, quint32 serverEventId);
+
+        EventRef ref(const Event *event) const;
+        Event *resolve(const EventRef &ref);
+
+    private:
+        Q_DISABLE_COPY(EventTable)
+
+        enum {
+            ChunkShift = 5,
+            ChunkSize = 1 << ChunkShift,
+            MaxIdleNames = 64           // Names without events kept around for reuse
+        };
+
+        struct NameChain {
+            int first;                  // -1 if there are no events with the name
+            int last;
+        };
+
+        Event *storage(int slot) const;
+        void grow();
+        void linkName(Event *event);
+        void unlinkName(Event *event);
+        void purgeIdleNames();
+
+        QVector<Event*> m_chunks;
+        int m_firstFree;
+        int m_count;
+        int m_highWaterMark;
+        EventIndex m_byClientId;
+        EventIndex m_byServerId;
+        QHash<QString, NameChain> m_byName;
+        int m_idleNames;
+    };
+}
+
+#endif
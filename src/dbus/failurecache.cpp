@@ -0,0 +1,103 @@
+/*
+ * NgfClient - Qt Non-Graphic Feedback daemon client library
+ *
+ * Copyright (C) 2026 Jolla Ltd.
+ * Contact: juho.hamalainen@jolla.com
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "failurecache.h"
+
+namespace Ngf
+{
+    const static int FailuresBeforeBackOff  = 2;
+    const static int InitialBackOff         = 1000;     // [ms]
+    const static int MaximumBackOff         = 60000;    // [ms]
+    const static int MaximumEntries         = 64;
+}
+
+bool Ngf::FailureCache::isEmpty() const
+{
+    return m_entries.isEmpty();
+}
+
+int Ngf::FailureCache::count() const
+{
+    return m_entries.count();
+}
+
+bool Ngf::FailureCache::isBlocked(const QString &event, uint propertyHash,
+                                  const QVariantMap &properties, qint64 now) const
+{
+    QHash<QPair<QString, uint>, Entry>::const_iterator it = m_entries.constFind(qMakePair(event, propertyHash));
+
+    return it != m_entries.constEnd() && it.value().blockedUntil > now
+            && it.value().properties == properties;
+}
+
+void Ngf::FailureCache::failed(const QString &event, uint propertyHash,
+                               const QVariantMap &properties, qint64 now)
+{
+    QHash<QPair<QString, uint>, Entry>::iterator it = m_entries.find(qMakePair(event, propertyHash));
+
+    if (it == m_entries.end() || it.value().properties != properties) {
+        if (it == m_entries.end() && m_entries.count() >= MaximumEntries)
+            evictOldest();
+
+        Entry entry;
+        entry.properties = properties;
+        entry.failures = 0;
+        entry.blockedUntil = 0;
+        it = m_entries.insert(qMakePair(event, propertyHash), entry);
+    }
+
+    Entry &entry = it.value();
+    entry.lastFailure = now;
+
+    if (++entry.failures < FailuresBeforeBackOff)
+        return;
+
+    // Double the period for every failure, without overflowing the shift
+    const int doublings = qMin(entry.failures - FailuresBeforeBackOff, 16);
+    entry.blockedUntil = now + qMin<qint64>(qint64(InitialBackOff) << doublings, MaximumBackOff);
+}
+
+void Ngf::FailureCache::succeeded(const QString &event, uint propertyHash,
+                                  const QVariantMap &properties)
+{
+    QHash<QPair<QString, uint>, Entry>::iterator it = m_entries.find(qMakePair(event, propertyHash));
+
+    if (it != m_entries.end() && it.value().properties == properties)
+        m_entries.erase(it);
+}
+
+void Ngf::FailureCache::clear()
+{
+    m_entries.clear();
+}
+
+void Ngf::FailureCache::evictOldest()
+{
+    // The cache is small and only scanned when full
+    QHash<QPair<QString, uint>, Entry>::iterator oldest = m_entries.begin();
+
+    for (QHash<QPair<QString, uint>, Entry>::iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it.value().lastFailure < oldest.value().lastFailure)
+            oldest = it;
+    }
+
+    if (oldest != m_entries.end())
+        m_entries.erase(oldest);
+}
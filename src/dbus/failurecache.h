@@ -0,0 +1,69 @@
+/*
+ * NgfClient - Qt Non-Graphic Feedback daemon client library
+ *
+ * Copyright (C) 2026 Jolla Ltd.
+ * Contact: juho.hamalainen@jolla.com
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef NGFFAILURECACHE_H
+#define NGFFAILURECACHE_H
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QVariantMap>
+
+namespace Ngf
+{
+    /*
+     * Events which NGF daemon fails right away, by event name and property hash.
+     *
+     * Events failing quickly again and again, for example vibra feedback while vibra is
+     * disabled in the profile, are blocked for a back-off period which doubles with every
+     * further failure. Once the period is over, the next play goes through to find out
+     * whether the event still fails. Entries are told apart by their full properties, an
+     * entry with the same hash but other properties is replaced. The cache holds a
+     * limited number of entries, the one which failed longest ago makes room for a new
+     * one. Used from the thread the client lives in only.
+     */
+    class FailureCache
+    {
+    public:
+        bool isEmpty() const;
+        int count() const;
+        bool isBlocked(const QString &event, uint propertyHash, const QVariantMap &properties,
+                       qint64 now) const;
+        void failed(const QString &event, uint propertyHash, const QVariantMap &properties,
+                    qint64 now);
+        void succeeded(const QString &event, uint propertyHash, const QVariantMap &properties);
+        void clear();
+
+    private:
+        struct Entry
+        {
+            QVariantMap properties;
+            int failures;
+            qint64 blockedUntil;    // [ms]
+            qint64 lastFailure;     // [ms]
+        };
+
+        void evictOldest();
+
+        QHash<QPair<QString, uint>, Entry> m_entries;
+    };
+}
+
+#endif
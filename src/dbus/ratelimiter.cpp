@@ -0,0 +1,70 @@
+/*
+ * NgfClient - Qt Non-Graphic Feedback daemon client library
+ *
+ * Copyright (C) 2026 Jolla Ltd.
+ * Contact: juho.hamalainen@jolla.com
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "ratelimiter.h"
+
+Ngf::RateLimiter::RateLimiter()
+    : m_limitCount(0)
+{
+    m_clock.start();
+}
+
+void Ngf::RateLimiter::setLimit(const QString &event, qreal rate, int burst)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (rate <= 0) {
+        m_buckets.remove(event);
+    } else {
+        // A new bucket starts full
+        Bucket bucket;
+        bucket.rate = rate;
+        bucket.burst = qMax(1, burst);
+        bucket.tokens = bucket.burst;
+        bucket.updated = m_clock.elapsed();
+        m_buckets.insert(event, bucket);
+    }
+
+    m_limitCount.storeRelease(m_buckets.count());
+}
+
+bool Ngf::RateLimiter::admit(const QString &event)
+{
+    if (!m_limitCount.loadAcquire())
+        return true;
+
+    QMutexLocker locker(&m_mutex);
+    QHash<QString, Bucket>::iterator it = m_buckets.find(event);
+
+    if (it == m_buckets.end())
+        return true;
+
+    const qint64 now = m_clock.elapsed();
+    Bucket &bucket = it.value();
+
+    bucket.tokens = qMin(bucket.burst, bucket.tokens + (now - bucket.updated) * bucket.rate / 1000);
+    bucket.updated = now;
+
+    if (bucket.tokens < 1)
+        return false;
+
+    bucket.tokens -= 1;
+    return true;
+}
@@ -0,0 +1,64 @@
+/*
+ * NgfClient - Qt Non-Graphic Feedback daemon client library
+ *
+ * Copyright (C) 2026 Jolla Ltd.
+ * Contact: juho.hamalainen@jolla.com
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef NGFRATELIMITER_H
+#define NGFRATELIMITER_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+namespace Ngf
+{
+    /*
+     * Token bucket rate limits for plays, by event name.
+     *
+     * Each limited event has a bucket holding up to burst tokens, refilled at rate tokens
+     * per second. Every play of the event takes a token, and plays finding the bucket empty
+     * are dropped. Plays may come from any thread, so the buckets are guarded by a mutex,
+     * which isn't taken at all while no limits are set.
+     */
+    class RateLimiter
+    {
+    public:
+        RateLimiter();
+
+        void setLimit(const QString &event, qreal rate, int burst);   // rate <= 0 removes
+        bool admit(const QString &event);                               // False if dropped
+
+    private:
+        struct Bucket
+        {
+            qreal rate;         // [1/s]
+            qreal burst;
+            qreal tokens;
+            qint64 updated;     // [ms] m_clock time tokens were last refilled
+        };
+
+        QMutex m_mutex;
+        QHash<QString, Bucket> m_buckets;
+        QAtomicInt m_limitCount;
+        QElapsedTimer m_clock;
+    };
+}
+
+#endif
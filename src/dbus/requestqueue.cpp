@@ -0,0 +1,80 @@
+/*
+ * NgfClient - Qt Non-Graphic Feedback daemon client library
+ *
+ * Copyright (C) 2026 Jolla Ltd.
+ * Contact: juho.hamalainen@jolla.com
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "requestqueue.h"
+
+Ngf::Request::Request(Type type)
+    : type(type),
+      clientEventId(0),
+      state(StateNew),
+      replyTimeout(-1),
+      propertyHash(0),
+      waiter(0),
+      next(0)
+{
+}
+
+Ngf::RequestQueue::RequestQueue()
+    : m_head(0)
+{
+}
+
+Ngf::RequestQueue::~RequestQueue()
+{
+    Request *request = takeAll();
+
+    while (request) {
+        Request *next = request->next;
+        delete request;
+        request = next;
+    }
+}
+
+bool Ngf::RequestQueue::push(Request *request)
+{
+    Request *head;
+
+    do {
+        head = m_head.loadAcquire();
+        request->next = head;
+    } while (!m_head.testAndSetRelease(head, request));
+
+    return head == 0;
+}
+
+Ngf::Request *Ngf::RequestQueue::takeAll()
+{
+    Request *request = m_head.fetchAndStoreAcquire(0);
+    Request *oldest = 0;
+
+    while (request) {
+        Request *next = request->next;
+        request->next = oldest;
+        oldest = request;
+        request = next;
+    }
+
+    return oldest;
+}
+
+bool Ngf::RequestQueue::isEmpty() const
+{
+    return m_head.loadAcquire() == 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * NgfClient - Qt Non-Graphic Feedback daemon client library
+ *
+ * Copyright (C) 2026 Jolla Ltd.
+ * Contact: juho.hamalainen@jolla.com
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef NGFREQUESTQUEUE_H
+#define NGFREQUESTQUEUE_H
+
+#include <QAtomicPointer>
+#include <QDBusMessage>
+#include <QString>
+#include "eventtable.h"
+
+namespace Ngf
+{
+    /*
+     * Request made from a thread other than the one the client lives in.
+     */
+    class Request
+    {
+    public:
+        enum Type {
+            Play,           // Play message, clientEventId is already handed out
+            PlayDetached,   // Play message without following the event
+            StateById,      // Change state of event clientEventId
+            StateByName,    // Change state of the first event with name
+            Await           // Hand waiter over to event clientEventId
+        };
+
+        Request(Type type);
+
+        Type type;
+        quint32 clientEventId;
+        QString name;
+        QDBusMessage message;
+        EventState state;
+        int replyTimeout;       // [ms] for Play, negative to use the client default
+        uint propertyHash;      // For Play
+        EventWaiter *waiter;    // For Await
+        Request *next;
+    };
+
+    /*
+     * Lock-free queue of requests with any number of producers and one consumer.
+     *
+     * Producers push to the head of a singly linked list with compare-and-swap. The consumer
+     * always takes the whole list at once, so there is no ABA problem, and reverses it to
+     * get the requests in the order they were pushed.
+     */
+    class RequestQueue
+    {
+    public:
+        RequestQueue();
+        ~RequestQueue();
+
+        bool push(Request *request);    // True if the queue was empty
+        Request *takeAll();             // Oldest request first, caller owns the list
+        bool isEmpty() const;
+
+    private:
+        Q_DISABLE_COPY(RequestQueue)
+
+        QAtomicPointer<Request> m_head;
+    };
+}
+
+#endif
@@ -0,0 +1,311 @@
+/*
+ * NgfClient - Qt Non-Graphic Feedback daemon client library
+ *
+ * Copyright (C) 2026 Jolla Ltd.
+ * Contact: juho.hamalainen@jolla.com
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QDBusServiceWatcher>
+#include <QPointer>
+#include <QThreadStorage>
+#include "statushub.h"
+#include "clientprivate.h"
+
+namespace Ngf
+{
+    const static QString HubDestination     = "com.nokia.NonGraphicFeedback1.Backend";
+    const static QString HubPath            = "/com/nokia/NonGraphicFeedback1";
+    const static QString HubInterface       = "com.nokia.NonGraphicFeedback1";
+    const static QString HubSignalStatus    = "Status";
+    const static QString BusService         = "org.freedesktop.DBus";
+    const static QString BusPath            = "/org/freedesktop/DBus";
+    const static QString BusInterface       = "org.freedesktop.DBus";
+    const static QString MethodGetNameOwner = "GetNameOwner";
+    const static QString ErrorNameHasNoOwner = "org.freedesktop.DBus.Error.NameHasNoOwner";
+
+    // Doesn't own the hub, it is deleted with its last client
+    static QThreadStorage<QPointer<StatusHub> > threadHub;
+}
+
+Ngf::StatusHub::StatusHub(const QDBusConnection &connection, bool shared)
+    : m_connection(connection),
+      m_serviceWatcher(new QDBusServiceWatcher(HubDestination, m_connection,
+                                               QDBusServiceWatcher::WatchForOwnerChange, this)),
+      m_clientCount(0),
+      m_dispatchDepth(0),
+      m_subscriberCount(0),
+      m_subscribed(false),
+      m_serviceAvailable(true),
+      m_shared(shared)
+{
+    QObject::connect(m_serviceWatcher, SIGNAL(serviceOwnerChanged(QString,QString,QString)),
+                     this, SLOT(ownerChanged(QString,QString,QString)));
+
+    // The bus answers before telling of the name changing owner after the question, so
+    // the watcher has the last word
+    QDBusMessage query = QDBusMessage::createMethodCall(BusService, BusPath, BusInterface,
+                                                        MethodGetNameOwner);
+    query << HubDestination;
+    m_connection.callWithCallback(query, this, SLOT(ownerQueried(QString)),
+                                  SLOT(ownerQueryFailed(QDBusError)));
+}
+
+Ngf::StatusHub::~StatusHub()
+{
+    if (m_subscribed)
+        m_connection.disconnect(HubDestination, HubPath, HubInterface, HubSignalStatus,
+                                this, SLOT(routeStatus(quint32,quint32,QDBusMessage)));
+}
+
+Ngf::StatusHub *Ngf::StatusHub::acquire(ClientPrivate *client, int *entry)
+{
+    StatusHub *hub = threadHub.localData();
+
+    if (!hub) {
+        hub = new StatusHub(QDBusConnection::systemBus(), true);
+        threadHub.setLocalData(QPointer<StatusHub>(hub));
+    }
+
+    *entry = hub->addClient(client);
+    return hub;
+}
+
+Ngf::StatusHub *Ngf::StatusHub::create(ClientPrivate *client, int *entry,
+                                       const QDBusConnection &connection)
+{
+    StatusHub *hub = new StatusHub(connection, false);
+
+    *entry = hub->addClient(client);
+    return hub;
+}
+
+int Ngf::StatusHub::addClient(ClientPrivate *client)
+{
+    // Entries of released clients are reused, so indexes held by the owner index stay
+    // valid only as long as the clients claiming them
+    int free = m_entries.size();
+
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (!m_entries.at(i).client) {
+            free = i;
+            break;
+        }
+    }
+
+    Entry added = { client, false, false };
+
+    if (free == m_entries.size())
+        m_entries.append(added);
+    else
+        m_entries[free] = added;
+
+    ++m_clientCount;
+    return free;
+}
+
+void Ngf::StatusHub::release(int entry)
+{
+    unsubscribe(entry);
+    setAwaitingPlays(entry, false);
+    m_entries[entry].client = 0;
+
+    if (--m_clientCount > 0 || m_dispatchDepth > 0)
+        return;
+
+    destroy(false);
+}
+
+void Ngf::StatusHub::beginDispatch()
+{
+    // Signal handlers of the clients may delete the last client while the hub is still
+    // going through them, the hub is deleted once it is done
+    ++m_dispatchDepth;
+}
+
+void Ngf::StatusHub::endDispatch()
+{
+    // The hub is still in a slot of its own, called by the service watcher or the bus
+    if (--m_dispatchDepth == 0 && m_clientCount == 0)
+        destroy(true);
+}
+
+void Ngf::StatusHub::destroy(bool later)
+{
+    // Clients created from here on get a new hub, whenever this one goes
+    if (m_shared && threadHub.hasLocalData() && threadHub.localData() == this)
+        threadHub.setLocalData(QPointer<StatusHub>());
+
+    if (later)
+        deleteLater();
+    else
+        delete this;
+}
+
+bool Ngf::StatusHub::subscribe(int entry)
+{
+    Entry &e = m_entries[entry];
+
+    if (!e.subscribed) {
+        if (!m_subscribed)
+            m_subscribed = m_connection.connect(HubDestination, HubPath, HubInterface,
+                                                HubSignalStatus, this,
+                                                SLOT(routeStatus(quint32,quint32,QDBusMessage)));
+        if (!m_subscribed)
+            return false;
+
+        e.subscribed = true;
+        ++m_subscriberCount;
+    }
+
+    return true;
+}
+
+void Ngf::StatusHub::unsubscribe(int entry)
+{
+    Entry &e = m_entries[entry];
+
+    if (!e.subscribed)
+        return;
+
+    e.subscribed = false;
+
+    if (--m_subscriberCount == 0 && m_subscribed) {
+        m_connection.disconnect(HubDestination, HubPath, HubInterface, HubSignalStatus,
+                                this, SLOT(routeStatus(quint32,quint32,QDBusMessage)));
+        m_subscribed = false;
+    }
+}
+
+void Ngf::StatusHub::claim(quint32 serverEventId, int entry)
+{
+    m_owners.insert(serverEventId, entry);
+}
+
+void Ngf::StatusHub::unclaim(quint32 serverEventId, int entry)
+{
+    // Server ids are unique per daemon instance, but a new daemon may hand out an id
+    // another client still holds on to
+    if (m_owners.value(serverEventId) == entry)
+        m_owners.remove(serverEventId);
+}
+
+void Ngf::StatusHub::setAwaitingPlays(int entry, bool awaiting)
+{
+    Entry &e = m_entries[entry];
+
+    if (e.awaitingPlays == awaiting)
+        return;
+
+    e.awaitingPlays = awaiting;
+
+    if (awaiting)
+        m_awaiting.append(entry);
+    else
+        m_awaiting.removeOne(entry);
+}
+
+int Ngf::StatusHub::clientCount() const
+{
+    return m_clientCount;
+}
+
+bool Ngf::StatusHub::isServiceAvailable() const
+{
+    return m_serviceAvailable;
+}
+
+QString Ngf::StatusHub::serviceOwner() const
+{
+    return m_serviceOwner;
+}
+
+void Ngf::StatusHub::lookUpOwner()
+{
+    QDBusMessage query = QDBusMessage::createMethodCall(BusService, BusPath, BusInterface,
+                                                        MethodGetNameOwner);
+    query << HubDestination;
+
+    const QDBusMessage reply = m_connection.call(query);
+
+    if (reply.type() == QDBusMessage::ReplyMessage && !reply.arguments().isEmpty())
+        ownerQueried(reply.arguments().at(0).toString());
+    else
+        ownerQueryFailed(QDBusError(reply));
+}
+
+void Ngf::StatusHub::ownerQueried(const QString &owner)
+{
+    m_serviceOwner = owner;
+    m_serviceAvailable = true;
+}
+
+void Ngf::StatusHub::ownerQueryFailed(const QDBusError &error)
+{
+    // Anything else than a missing owner leaves calls going to the well-known name
+    m_serviceOwner.clear();
+    if (error.name() == ErrorNameHasNoOwner)
+        m_serviceAvailable = false;
+}
+
+void Ngf::StatusHub::ownerChanged(const QString &service, const QString &oldOwner,
+                                  const QString &newOwner)
+{
+    // Owner is updated before the clients hear of the change, so whatever they send
+    // in response goes to the new daemon
+    m_serviceOwner = newOwner;
+    m_serviceAvailable = !newOwner.isEmpty();
+
+    beginDispatch();
+
+    if (oldOwner.isEmpty())
+        emit serviceRegistered(service);
+    else if (newOwner.isEmpty())
+        emit serviceUnregistered(service);
+
+    emit serviceOwnerChanged();
+
+    endDispatch();
+}
+
+void Ngf::StatusHub::routeStatus(quint32 serverEventId, quint32 state,
+                                 const QDBusMessage &message)
+{
+    // Signals from a daemon which has already given up the name are stale
+    if (!m_serviceOwner.isEmpty() && message.service() != m_serviceOwner)
+        return;
+
+    const int entry = m_owners.value(serverEventId);
+
+    beginDispatch();
+
+    if (entry >= 0) {
+        if (m_entries.at(entry).subscribed)
+            m_entries.at(entry).client->setEventState(serverEventId, state);
+    } else {
+        // Unknown id, the event may be one whose Play reply is still on the way to one
+        // of the clients waiting for them. Clients may come and go while handling the
+        // status, so a copy is gone through and the entries are checked on every round.
+        const QVector<int> awaiting = m_awaiting;
+
+        for (int i = 0; i < awaiting.size(); ++i) {
+            const Entry &e = m_entries.at(awaiting.at(i));
+            if (e.client && e.subscribed && e.awaitingPlays)
+                e.client->setEventState(serverEventId, state);
+        }
+    }
+
+    endDispatch();
+}
@@ -0,0 +1,114 @@
+/*
+ * NgfClient - Qt Non-Graphic Feedback daemon client library
+ *
+ * Copyright (C) 2026 Jolla Ltd.
+ * Contact: juho.hamalainen@jolla.com
+ *
+ * This work is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation.
+ *
+ * This work is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef NGFSTATUSHUB_H
+#define NGFSTATUSHUB_H
+
+#include <QObject>
+#include <QDBusConnection>
+#include <QVector>
+#include "eventtable.h"
+
+class QDBusServiceWatcher;
+
+namespace Ngf
+{
+    class ClientPrivate;
+
+    /*
+     * NGF daemon Status subscription and service watcher shared by the clients of a
+     * thread which talk to the daemon over the system bus.
+     *
+     * However many clients there are, one match rule is added and each Status signal is
+     * demarshalled once. Statuses of events played by the clients go to the client which
+     * played the event with one index lookup. Statuses of other events go to subscribed
+     * clients waiting for Play replies, as they may be for events whose Play reply hasn't
+     * arrived yet, and nowhere if none is waiting.
+     * The hub also keeps track of the unique name owning the NGF daemon bus name, so
+     * calls can be addressed to it and Status signals from anyone else dropped. Hubs are
+     * reference counted, created by the first client of a thread and deleted with the
+     * last one, or from the event loop once the hub is done calling clients if one of
+     * them deleted the last client. Clients with a bus connection of their own get a hub of their own. Used
+     * from the thread of the clients only.
+     */
+    class StatusHub : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        static StatusHub *acquire(ClientPrivate *client, int *entry);
+        static StatusHub *create(ClientPrivate *client, int *entry,
+                                 const QDBusConnection &connection);
+        void release(int entry);
+
+        bool subscribe(int entry);
+        void unsubscribe(int entry);
+        void claim(quint32 serverEventId, int entry);
+        void unclaim(quint32 serverEventId, int entry);
+        void setAwaitingPlays(int entry, bool awaiting);    // Play replies outstanding
+
+        int clientCount() const;
+        bool isServiceAvailable() const;    // True until known otherwise
+        QString serviceOwner() const;       // Empty if not known
+        void lookUpOwner();                 // Blocks for a round trip to the bus
+
+    signals:
+        void serviceRegistered(const QString &service);
+        void serviceUnregistered(const QString &service);
+        void serviceOwnerChanged();
+
+    private slots:
+        void routeStatus(quint32 serverEventId, quint32 state, const QDBusMessage &message);
+        void ownerQueried(const QString &owner);
+        void ownerQueryFailed(const QDBusError &error);
+        void ownerChanged(const QString &service, const QString &oldOwner,
+                          const QString &newOwner);
+
+    private:
+        StatusHub(const QDBusConnection &connection, bool shared);
+        virtual ~StatusHub();
+
+        int addClient(ClientPrivate *client);
+        void beginDispatch();
+        void endDispatch();
+        void destroy(bool later);
+
+        struct Entry {
+            ClientPrivate *client;      // 0 for a free entry
+            bool subscribed;
+            bool awaitingPlays;
+        };
+
+        QDBusConnection m_connection;
+        QDBusServiceWatcher *m_serviceWatcher;
+        QVector<Entry> m_entries;
+        QVector<int> m_awaiting;        // Entries of clients with Play replies outstanding
+        EventIndex m_owners;            // Server event id to entry of the client playing it
+        int m_clientCount;
+        int m_dispatchDepth;            // Calls to clients in progress, see beginDispatch()
+        int m_subscriberCount;
+        bool m_subscribed;
+        bool m_serviceAvailable;
+        QString m_serviceOwner;
+        bool m_shared;                  // Shared by the clients of a thread
+    };
+}
+
+#endif
@@ -22,7 +22,10 @@
 #define NGF_CLIENT_H
 
 #include <QObject>
+#include <QFuture>
 #include <QMap>
+#include <QPointer>
+#include <QSharedData>
 #include <QString>
 #include <QVariant>
 #include "ngfclient_global.h"
@@ -30,6 +33,54 @@
 namespace Ngf
 {
     class ClientPrivate;
+    class EventHandle;
+    class PreparedEventData;
+
+    /*!
+     * \class Ngf::PreparedEvent ngfclient.h NgfClient
+     *
+     * \brief Event with properties, ready to be played repeatedly
+     *
+     * Prepared event holds the event name and the daemon request for playing it with
+     * the given properties, so playing it again only needs the request to be sent.
+     * Use prepared events for events that are played often with the same properties,
+     * for example input feedback.
+     *
+     * Prepared events are created with Client::prepare() and played with
+     * Client::play(const PreparedEvent &). They are cheap to copy.
+     */
+    class NGFCLIENT_EXPORT PreparedEvent
+    {
+    public:
+        /*!
+         * Constructs an invalid prepared event.
+         */
+        PreparedEvent();
+        PreparedEvent(const PreparedEvent &other);
+        PreparedEvent &operator=(const PreparedEvent &other);
+        ~PreparedEvent();
+
+        /*!
+         * \return True if the event has been prepared by a client.
+         */
+        bool isValid() const;
+
+        /*!
+         * \return Name of the prepared event.
+         */
+        QString event() const;
+
+        /*!
+         * \return Properties of the prepared event.
+         */
+        QMap<QString, QVariant> properties() const;
+
+    private:
+        friend class ClientPrivate;
+        explicit PreparedEvent(PreparedEventData *data);
+
+        QExplicitlySharedDataPointer<PreparedEventData> d;
+    };
 
     /*!
      * \class Ngf::Client ngfclient.h NgfClient
@@ -49,6 +100,11 @@ namespace Ngf
      * NGF::Client is introduced to allow simple use of NGF daemon without the need to know communication
      * details between daemon and client.
      *
+     * Events can be played, paused, resumed and stopped from any thread. Requests made from other
+     * threads than the one the client lives in return right away and are handed over to the client
+     * thread, which sends them to NGF daemon. Signals are emitted in the client thread. Other
+     * functions must be called from the client thread.
+     *
      * \section LICENSE
      *
      * NgfClient - Qt Non-Graphic Feedback daemon client library
@@ -108,6 +164,37 @@ namespace Ngf
         Q_OBJECT
 
     public:
+        /*!
+         * What to do with plays made while the in-flight limit is reached.
+         *
+         * \sa setMaxInFlight()
+         */
+        enum OverflowPolicy {
+            QueueOverflow,      //!< Hold plays back until NGF daemon catches up.
+            RejectOverflow      //!< Refuse plays, play() returns 0.
+        };
+
+        /*!
+         * State of an event followed by the client.
+         *
+         * \sa state()
+         */
+        enum EventState {
+            EventUnknown,       //!< Not followed: never played, ended, failed or detached.
+            EventStarting,      //!< Waiting for NGF daemon to start the event.
+            EventPlaying,       //!< Playing according to NGF daemon.
+            EventPaused,        //!< Paused according to NGF daemon.
+            EventStopping       //!< Stop requested, waiting for NGF daemon to end the event.
+        };
+
+        /*!
+         * How an event played with playAsync() ended.
+         */
+        enum EventResult {
+            ResultCompleted,    //!< Event completed or was stopped.
+            ResultFailed        //!< Event failed, or couldn't be played at all.
+        };
+
         /*!
          * Constructs new client instance.
          *
@@ -165,6 +252,130 @@ namespace Ngf
          */
         virtual quint32 play(const QString &event, const QMap<QString, QVariant> &properties);
 
+        /*!
+         * Play event and get a handle owning it.
+         *
+         * The event is stopped when the handle is destroyed, so it can't be left playing
+         * by accident. Requests made through the handle go straight to the event.
+         *
+         * \param event String name of wanted event.
+         * \param properties Extra properties for new event in key:value pairs.
+         * \return Handle of the new event, invalid if no connection to NGF daemon.
+         * \sa EventHandle
+         */
+        EventHandle playHandle(const QString &event,
+                               const QMap<QString, QVariant> &properties = QMap<QString, QVariant>());
+
+        /*!
+         * Play prepared event and get a handle owning it.
+         *
+         * \param event Event prepared by this client.
+         * \return Handle of the new event, invalid if no connection to NGF daemon or the
+         *         event is invalid.
+         * \sa playHandle(const QString &, const QMap<QString, QVariant> &)
+         */
+        EventHandle playHandle(const PreparedEvent &event);
+
+        /*!
+         * Play event and get a future for its end.
+         *
+         * The future is finished with the result of the event when it completes or fails,
+         * and its progress goes from 0 to 1 when NGF daemon starts playing the event. The
+         * client reports to the future of the event only, so chaining events this way
+         * doesn't need the event signals.
+         *
+         * With C++20 coroutines the future can be awaited with EventAwaiter.
+         *
+         * \param event String name of wanted event.
+         * \param properties Extra properties for new event in key:value pairs.
+         * \return Future of the event, finished with ResultFailed right away if the
+         *         event couldn't be played.
+         */
+        QFuture<EventResult> playAsync(const QString &event,
+                                       const QMap<QString, QVariant> &properties = QMap<QString, QVariant>());
+
+        /*!
+         * Play prepared event and get a future for its end.
+         *
+         * \param event Event prepared by this client.
+         * \return Future of the event.
+         * \sa playAsync(const QString &, const QMap<QString, QVariant> &)
+         */
+        QFuture<EventResult> playAsync(const PreparedEvent &event);
+
+        /*!
+         * Play event with a reply timeout of its own.
+         *
+         * \param event String name of wanted event.
+         * \param properties Extra properties for new event in key:value pairs.
+         * \param replyTimeout Milliseconds to wait for NGF daemon to start the event, 0 to
+         *        wait as long as D-Bus does, or negative to use replyTimeout().
+         * \return 0 if no connection to NGF daemon or identifier of new event on success.
+         * \sa setReplyTimeout()
+         */
+        quint32 play(const QString &event, const QMap<QString, QVariant> &properties,
+                     int replyTimeout);
+
+        /*!
+         * Prepare event for playing.
+         *
+         * Creates the daemon request for playing the event up front, so that the event can
+         * be played many times without building the request again. Preparing doesn't
+         * require connection to NGF daemon.
+         *
+         * \param event String name of wanted event.
+         * \param properties Extra properties for the event in key:value pairs.
+         * \return Prepared event to be passed to play(const PreparedEvent &).
+         */
+        PreparedEvent prepare(const QString &event,
+                              const QMap<QString, QVariant> &properties = QMap<QString, QVariant>()) const;
+
+        /*!
+         * Play prepared event.
+         *
+         * Behaves like play(const QString &, const QMap<QString, QVariant> &) with the name and
+         * properties the event was prepared with.
+         *
+         * \param event Event returned by prepare().
+         * \return 0 if event is invalid or identifier of new event on success.
+         */
+        quint32 play(const PreparedEvent &event);
+
+        /*!
+         * Play prepared event with a reply timeout of its own.
+         *
+         * \param event Event returned by prepare().
+         * \param replyTimeout Milliseconds to wait for NGF daemon to start the event, 0 to
+         *        wait as long as D-Bus does, or negative to use replyTimeout().
+         * \return 0 if event is invalid or identifier of new event on success.
+         */
+        quint32 play(const PreparedEvent &event, int replyTimeout);
+
+        /*!
+         * Play event without following it.
+         *
+         * The request is sent to NGF daemon without expecting a reply and the client doesn't
+         * keep any record of the event, so no status signals are emitted for it and it
+         * can't be paused or stopped. This is the cheapest way to play short events, for
+         * example input feedback.
+         *
+         * \param event String name of wanted event.
+         * \param properties Extra properties for new event in key:value pairs.
+         * \return True if the request was sent.
+         */
+        bool playDetached(const QString &event,
+                          const QMap<QString, QVariant> &properties = QMap<QString, QVariant>());
+
+        /*!
+         * Play prepared event without following it.
+         *
+         * \sa playDetached(const QString &, const QMap<QString, QVariant> &)
+         *
+         * \param event Event returned by prepare().
+         * \return True if the request was sent.
+         */
+        bool playDetached(const PreparedEvent &event);
+
         /*!
          * Pause running event by id.
          *
@@ -219,6 +430,420 @@ namespace Ngf
          */
         virtual bool stop(const QString &event);
 
+        /*!
+         * Get state of an event.
+         *
+         * The state is the one last reported with the event signals, looked up from the
+         * events the client follows anyway, so there is no need to keep track of event
+         * signals just to know the state. Pause and resume requests show once NGF daemon
+         * has carried them out, stop requests right away.
+         *
+         * \param eventId Identifier returned by play().
+         * \return State of the event, EventUnknown if the client doesn't follow it.
+         */
+        EventState state(quint32 eventId) const;
+
+        /*!
+         * Get events the client follows.
+         *
+         * \return Identifiers of the events not ended or stopped yet, in no particular
+         *         order.
+         */
+        QList<quint32> activeEvents() const;
+
+        /*!
+         * Begin batch of requests.
+         *
+         * Until commitBatch() is called, play, pause, resume and stop requests are collected
+         * instead of being sent to NGF daemon. Played events get their identifiers right
+         * away and can be paused or stopped within the same batch. Batches may be nested,
+         * requests are sent when the outermost batch is committed.
+         *
+         * \return Identifier of the batch, passed to batchFinished(quint32).
+         */
+        quint32 beginBatch();
+
+        /*!
+         * Send requests of the batch to NGF daemon.
+         *
+         * All collected requests are sent back to back. Signal batchFinished(quint32) is
+         * emitted once NGF daemon has replied to every request of the batch, state of the
+         * individual events is reported with the event signals as usual.
+         *
+         * \return Identifiers of the events played in the batch.
+         */
+        QList<quint32> commitBatch();
+
+        /*!
+         * Set how long pause, resume and stop requests are held back before sending.
+         *
+         * State requests are not sent right away. Requests made for the same event within
+         * the interval are merged, and only the last wanted state is sent to NGF daemon,
+         * so for example pausing and resuming an event in one go doesn't send anything.
+         * The default interval 0 sends requests on the next pass of the event loop.
+         *
+         * \param msec Interval in milliseconds.
+         */
+        void setCoalescingInterval(int msec);
+
+        /*!
+         * Get interval state requests are held back before sending.
+         *
+         * \return Interval in milliseconds.
+         */
+        int coalescingInterval() const;
+
+        /*!
+         * Set how long to wait for NGF daemon to start a played event.
+         *
+         * If NGF daemon doesn't reply to a play request in time, eventFailed(quint32) is
+         * emitted for the event and the client stops following it. Should the event still
+         * start later on, it is stopped. By default the client waits as long as D-Bus
+         * does, some 25 seconds. Feedback is pointless when late, so clients playing
+         * feedback events should use a timeout of some hundreds of milliseconds.
+         *
+         * \param msec Timeout in milliseconds, 0 to wait as long as D-Bus does.
+         */
+        void setReplyTimeout(int msec);
+
+        /*!
+         * Get how long to wait for NGF daemon to start a played event.
+         *
+         * \return Timeout in milliseconds.
+         */
+        int replyTimeout() const;
+
+        /*!
+         * Set how many play requests may wait for a reply from NGF daemon at a time.
+         *
+         * Once the limit is reached signal congested() is emitted, and further plays are
+         * handled according to overflowPolicy(). Signal drained() is emitted when no
+         * plays are held back and at most half of the limit is in flight.
+         *
+         * \param requests Maximum number of requests in flight, 0 for no limit. There is
+         *        no limit by default.
+         */
+        void setMaxInFlight(int requests);
+
+        /*!
+         * Get how many play requests may wait for a reply from NGF daemon at a time.
+         *
+         * \return Maximum number of requests in flight, 0 if there is no limit.
+         */
+        int maxInFlight() const;
+
+        /*!
+         * Set what to do with plays made while the in-flight limit is reached.
+         *
+         * With QueueOverflow, the default, play() hands out an identifier as usual and the
+         * request is sent once earlier ones have been replied to. With RejectOverflow,
+         * play() returns 0 until the client has drained.
+         *
+         * \param policy Overflow policy.
+         */
+        void setOverflowPolicy(OverflowPolicy policy);
+
+        /*!
+         * Get what to do with plays made while the in-flight limit is reached.
+         *
+         * \return Overflow policy.
+         */
+        OverflowPolicy overflowPolicy() const;
+
+        /*!
+         * Limit how often an event can be played.
+         *
+         * Plays of the event are let through at the given average rate, with up to burst
+         * plays in quick succession. Excess plays are dropped before any request is
+         * built: play() returns 0, playDetached() returns true as the play merges into
+         * the ones let through, and eventDropped(const QString &) is emitted. Use this for
+         * input feedback, which fires faster than anyone can feel it. Limits apply to
+         * plays from all threads.
+         *
+         * \param event String name of the event.
+         * \param rate Plays per second, 0 to remove the limit.
+         * \param burst Number of plays allowed back to back.
+         */
+        void setRateLimit(const QString &event, qreal rate, int burst = 1);
+
+        /*!
+         * Set how long an event may go without news from NGF daemon.
+         *
+         * Events are normally followed until NGF daemon reports them completed or failed.
+         * Should that report get lost, the event would be followed for the lifetime of the
+         * client. Events NGF daemon hasn't said anything of for longer than the timeout
+         * are stopped and reported with eventFailed(quint32). Events are checked at a low
+         * frequency, so an event may be kept up to half the timeout longer, and at most a
+         * minute. Don't set this shorter than the longest events played without status
+         * changes, looping events included.
+         *
+         * \param msec Timeout in milliseconds, 0 to follow events until they end. Events
+         *        are followed until they end by default.
+         */
+        void setStaleEventTimeout(int msec);
+
+        /*!
+         * Get how long an event may go without news from NGF daemon.
+         *
+         * \return Timeout in milliseconds, 0 if events are followed until they end.
+         */
+        int staleEventTimeout() const;
+
+        /*!
+         * Set how many events the client follows at a time.
+         *
+         * When more events are played, the ones NGF daemon has been quiet about the
+         * longest are stopped and reported with eventFailed(quint32) on the next pass of
+         * the event loop. Events still waiting for NGF daemon to start them are left to
+         * the reply timeout.
+         *
+         * \param events Maximum number of events, 0 for no limit. There is no limit by
+         *        default.
+         * \sa setReplyTimeout()
+         */
+        void setMaxEvents(int events);
+
+        /*!
+         * Get how many events the client follows at a time.
+         *
+         * \return Maximum number of events, 0 if there is no limit.
+         */
+        int maxEvents() const;
+
+        /*!
+         * Set how many plays may wait for NGF daemon to appear.
+         *
+         * Plays made while NGF daemon is known to be missing from the system bus, for
+         * example before it has started at boot, would fail only after a round trip.
+         * Instead they wait in the client and are sent together once NGF daemon takes its
+         * name. Plays beyond the limit fail right away with eventFailed(quint32), as do
+         * plays still waiting when the offline timeout is up. Events waiting are reported
+         * as starting and can be stopped, paused and resumed like events being started.
+         * Plays on a peer connection are always sent.
+         *
+         * \param plays Maximum number of plays waiting, 0 to always send plays. Plays
+         *        are always sent by default.
+         * \sa setOfflineTimeout()
+         */
+        void setMaxOfflinePlays(int plays);
+
+        /*!
+         * Get how many plays may wait for NGF daemon to appear.
+         *
+         * \return Maximum number of plays waiting, 0 if plays are always sent.
+         */
+        int maxOfflinePlays() const;
+
+        /*!
+         * Set how long a play may wait for NGF daemon to appear.
+         *
+         * Applies to plays made after setting it.
+         *
+         * \param msec Timeout in milliseconds, 0 to wait as long as it takes. The
+         *        default is 5000 milliseconds.
+         * \sa setMaxOfflinePlays()
+         */
+        void setOfflineTimeout(int msec);
+
+        /*!
+         * Get how long a play may wait for NGF daemon to appear.
+         *
+         * \return Timeout in milliseconds, 0 if plays wait as long as it takes.
+         */
+        int offlineTimeout() const;
+
+        /*!
+         * Set whether events survive NGF daemon restarting.
+         *
+         * Normally the events are forgotten when NGF daemon goes away. With recovery,
+         * events which were playing or paused are kept, and once NGF daemon is back they
+         * are played again together in their wanted state, keeping their ids.
+         * eventPlaying(quint32) is emitted again for each of them when it has restarted.
+         * Meanwhile they are reported as starting, and stopping one just ends it with
+         * eventCompleted(quint32). Only events played while recovery is enabled can be
+         * recovered. Recovery works on the system bus only, a peer connection going away
+         * is not followed.
+         *
+         * \param enabled True to recover events. Events are not recovered by default.
+         */
+        void setRecoveryEnabled(bool enabled);
+
+        /*!
+         * Get whether events survive NGF daemon restarting.
+         *
+         * \return True if events are recovered.
+         */
+        bool isRecoveryEnabled() const;
+
+        /*!
+         * Set whether event status is followed while no events are played.
+         *
+         * NGF daemon broadcasts status changes of all events it plays, including events
+         * played by other processes. By default the client receives them as long as it is
+         * connected. When not subscribed while idle, the client only receives them while
+         * it has events of its own, so it isn't woken up when other processes play events.
+         * This suits clients which play events rarely, each time the client goes from idle
+         * to playing and back costs an extra request to the bus daemon.
+         *
+         * \param subscribed False to follow event status only while playing events.
+         */
+        void setSubscribedWhenIdle(bool subscribed);
+
+        /*!
+         * Get whether event status is followed while no events are played.
+         *
+         * \return True if event status is followed whenever the client is connected.
+         */
+        bool isSubscribedWhenIdle() const;
+
+        /*!
+         * Set whether connect() waits to know where NGF daemon is on the system bus.
+         *
+         * Requests are addressed to the unique bus name of NGF daemon, so the bus daemon
+         * doesn't have to resolve the well-known name for each of them, and status
+         * changes from anyone else are ignored. The unique name is looked up when the
+         * first client of a thread connects, and followed as NGF daemon comes and goes.
+         * Until the answer arrives requests go to the well-known name. With eager lookup
+         * connect() waits for the answer, so even the first requests go straight to NGF
+         * daemon, at the cost of one round trip to the bus daemon. Must be set before
+         * connect().
+         *
+         * \param eager True to look up NGF daemon in connect().
+         */
+        void setEagerOwnerLookup(bool eager);
+
+        /*!
+         * Get whether connect() waits to know where NGF daemon is on the system bus.
+         *
+         * \return True if NGF daemon is looked up in connect().
+         */
+        bool isEagerOwnerLookup() const;
+
+        /*!
+         * Set whether the client has a system bus connection of its own.
+         *
+         * By default the client shares the system bus connection of the application, so
+         * its requests, replies and status changes queue up with everything else the
+         * application sends and receives, such as floods of property change signals.
+         * With a private connection, feedback traffic has a socket of its own and the
+         * client is seen on the bus under a unique name of its own. Together with
+         * setThreadedDispatch() the traffic doesn't wait for the application event loop
+         * either. Each private connection takes a file descriptor and some memory in the
+         * bus daemon. Must be set before connect().
+         *
+         * \param enabled True to open a connection of its own.
+         */
+        void setPrivateConnection(bool enabled);
+
+        /*!
+         * Get whether the client has a system bus connection of its own.
+         *
+         * \return True if a private connection is used.
+         */
+        bool isPrivateConnection() const;
+
+        /*!
+         * Set address of a private NGF daemon socket.
+         *
+         * When an address is set, connect() connects straight to NGF daemon at the address
+         * instead of going through the system bus, which saves the bus daemon hops from
+         * every request. If the connection can't be made, or it is lost later on, the
+         * client falls back to the system bus. The address must be set before connect()
+         * is called. By default it is taken from environment variable NGF_PEER_ADDRESS.
+         *
+         * \param address D-Bus address, for example "unix:path=/run/ngfd/socket".
+         */
+        void setPeerAddress(const QString &address);
+
+        /*!
+         * Get address of a private NGF daemon socket.
+         *
+         * \return D-Bus address, or empty string if the system bus is used.
+         */
+        QString peerAddress() const;
+
+        /*!
+         * Set whether the client talks to NGF daemon from a thread of its own.
+         *
+         * By default replies and status changes from NGF daemon are handled in the client
+         * thread, so while that thread is busy, requests made from other threads and the
+         * follow-up requests of playing events are delayed. With threaded dispatch the
+         * events are tracked and D-Bus traffic is handled in an internal thread, and only
+         * the signals are delivered to the client thread. Must be set before connect().
+         *
+         * \param enabled True to dispatch in a thread of its own.
+         */
+        void setThreadedDispatch(bool enabled);
+
+        /*!
+         * Get whether the client talks to NGF daemon from a thread of its own.
+         *
+         * \return True if threaded dispatch has been enabled.
+         */
+        bool isThreadedDispatch() const;
+
+        /*!
+         * Get client statistics.
+         *
+         * Statistics describe the bookkeeping done by the client and are meant for
+         * diagnostics and benchmarking. Currently reported values are:
+         *
+         * \li \c transport \c "peer" if connected straight to NGF daemon, \c "private" on
+         *     a system bus connection of its own, \c "bus" otherwise.
+         * \li \c statusSubscribed Whether event status signals are currently received.
+         * \li \c serviceAvailable Whether NGF daemon is on the system bus, always true
+         *     on a peer connection.
+         * \li \c serviceOwner Unique bus name of NGF daemon, empty if not known or on a
+         *     peer connection.
+         * \li \c sharedClients Number of clients in the thread sharing the status
+         *     subscription on the system bus, 0 when talking to a peer.
+         * \li \c events Number of events currently tracked.
+         * \li \c eventCapacity Number of event slots allocated. Slots are reused, so this
+         *     only grows when more events are tracked at the same time than ever before.
+         * \li \c eventHighWaterMark Most events tracked at the same time.
+         * \li \c eventTableBytes Memory used by the event table. The table never
+         *     shrinks, so this is also its memory high-water mark.
+         * \li \c plays Number of events played and followed by the client.
+         * \li \c detachedPlays Number of events played with playDetached().
+         * \li \c batches Number of committed batches.
+         * \li \c pendingReplies Number of requests waiting for a reply from NGF daemon.
+         * \li \c replyReceivers Number of objects created for receiving replies, reused
+         *     for later requests once their reply is in.
+         * \li \c inFlight Number of play requests waiting for a reply from NGF daemon.
+         * \li \c queueDepth Number of plays held back by the in-flight limit.
+         * \li \c rejectedPlays Number of plays refused by the in-flight limit.
+         * \li \c droppedPlays Number of plays dropped by rate limits.
+         * \li \c failureCacheEntries Number of events remembered for failing right away.
+         * \li \c shortCircuitedPlays Number of plays failed without asking NGF daemon.
+         * \li \c earlyStatuses Number of event statuses received before the reply to
+         *     the play request and applied once the reply arrived.
+         * \li \c replyTimeouts Number of events failed for NGF daemon not replying in time.
+         * \li \c sweeps Number of times events were checked for being stale.
+         * \li \c sweptEvents Number of events reclaimed as stale or over the
+         *     maximum number of events.
+         * \li \c sweepTime Microseconds spent checking events in total.
+         * \li \c sweepBytes Memory kept by the checks for reuse.
+         * \li \c recoveries Number of times NGF daemon came back with recovery enabled.
+         * \li \c recoveredEvents Number of events played again after NGF daemon came back.
+         * \li \c outageTime Milliseconds NGF daemon was away the last time.
+         * \li \c recoveryTime Milliseconds from NGF daemon coming back the last time to
+         *     all replayed events being started or failed.
+         * \li \c offlinePlays Number of plays which waited for NGF daemon to appear.
+         * \li \c offlineQueueDepth Number of plays waiting for NGF daemon to appear.
+         * \li \c offlineOverflows Number of plays failed for too many plays waiting.
+         * \li \c offlineExpiredPlays Number of plays failed for NGF daemon not
+         *     appearing in time.
+         * \li \c stateRequests Number of pause, resume and stop requests sent.
+         * \li \c elidedStateRequests Number of pause, resume and stop requests merged
+         *     into later ones and never sent.
+         * \li \c queuedRequests Number of requests handed over from other threads.
+         * \li \c threadedDispatch Whether the client talks to NGF daemon from a thread
+         *     of its own.
+         *
+         * \return Map of statistic names to their values.
+         */
+        QVariantMap statistics() const;
+
     signals:
 
         /*!
@@ -256,12 +881,187 @@ namespace Ngf
          */
         void eventPaused(quint32 event_id);
 
+        /*!
+         * Signal emitted when NGF daemon has replied to all requests of a batch.
+         *
+         * \param batch_id Batch identifier number returned by beginBatch().
+         */
+        void batchFinished(quint32 batch_id);
+
+        /*!
+         * Signal emitted when the in-flight limit is reached.
+         *
+         * \sa setMaxInFlight()
+         */
+        void congested();
+
+        /*!
+         * Signal emitted when the client has caught up after being congested.
+         *
+         * \sa setMaxInFlight()
+         */
+        void drained();
+
+        /*!
+         * Signal emitted when a play is dropped by the rate limit of the event.
+         *
+         * \param event String name of the event.
+         * \sa setRateLimit()
+         */
+        void eventDropped(const QString &event);
+
     private:
         Q_DISABLE_COPY(Client)
         Q_DECLARE_PRIVATE(Client)
         ClientPrivate* const d_ptr;
     };
 
+    /*!
+     * \class Ngf::EventHandle ngfclient.h NgfClient
+     *
+     * \brief Owner of a played event
+     *
+     * Event handle stops its event when destroyed, unless the event has been detached
+     * from it. Handles can be moved but not copied, so an event has one owner at a time.
+     * Pausing, resuming and stopping through a handle finds the event without looking
+     * up its identifier, as long as the handle is used in the thread events are
+     * dispatched in.
+     *
+     * Handles are returned by Client::playHandle(). A handle outliving its client does
+     * nothing.
+     */
+    class NGFCLIENT_EXPORT EventHandle
+    {
+    public:
+        /*!
+         * Constructs an invalid handle.
+         */
+        EventHandle();
+        EventHandle(EventHandle &&other);
+
+        /*!
+         * Take over the event of another handle, stopping the event of this one.
+         */
+        EventHandle &operator=(EventHandle &&other);
+
+        /*!
+         * Stops the event unless it has been detached.
+         */
+        ~EventHandle();
+
+        /*!
+         * \return True if the handle owns an event.
+         */
+        bool isValid() const;
+
+        /*!
+         * \return Identifier of the event, 0 if the handle is invalid.
+         */
+        quint32 id() const;
+
+        /*!
+         * Unlike the other functions of the handle, the state is only known in the client
+         * thread, or in any thread with threaded dispatch.
+         *
+         * \return State of the event, EventUnknown in other threads.
+         * \sa Client::state()
+         */
+        Client::EventState state() const;
+
+        /*!
+         * Pause the event.
+         *
+         * \return False if the handle is invalid.
+         */
+        bool pause();
+
+        /*!
+         * Resume the event.
+         *
+         * \return False if the handle is invalid.
+         */
+        bool resume();
+
+        /*!
+         * Stop the event. The handle still refers to the event until destroyed.
+         *
+         * \return False if the handle is invalid.
+         */
+        bool stop();
+
+        /*!
+         * Let the event play on without the handle stopping it.
+         *
+         * \return Identifier of the event. The handle is invalid afterwards.
+         */
+        quint32 detach();
+
+    private:
+        Q_DISABLE_COPY(EventHandle)
+        friend class ClientPrivate;
+        EventHandle(ClientPrivate *client, quint32 id, int slot, quint32 generation);
+
+        QPointer<ClientPrivate> m_client;
+        quint32 m_id;
+        int m_slot;             // Slot of the event in the client event table, -1 if unknown
+        quint32 m_generation;
+    };
+}
+
+#if defined(__cpp_impl_coroutine)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#include <QFutureWatcher>
+
+namespace Ngf
+{
+    /*!
+     * \class Ngf::EventAwaiter ngfclient.h NgfClient
+     *
+     * \brief Awaits the end of an event in a C++20 coroutine
+     *
+     * \code
+     * if (co_await Ngf::EventAwaiter(client->playAsync("first")) == Ngf::Client::ResultCompleted)
+     *     client->play("second");
+     * \endcode
+     *
+     * The coroutine is resumed in the thread it was suspended in, which must run an event
+     * loop.
+     */
+    class EventAwaiter
+    {
+    public:
+        explicit EventAwaiter(const QFuture<Client::EventResult> &future)
+            : m_future(future)
+        {
+        }
+
+        bool await_ready() const
+        {
+            return m_future.isFinished();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            QFutureWatcher<Client::EventResult> *watcher = new QFutureWatcher<Client::EventResult>;
+            QObject::connect(watcher, &QFutureWatcher<Client::EventResult>::finished, watcher,
+                             [watcher, handle]() {
+                watcher->deleteLater();
+                handle.resume();
+            });
+            watcher->setFuture(m_future);
+        }
+
+        Client::EventResult await_resume() const
+        {
+            return m_future.result();
+        }
+
+    private:
+        QFuture<Client::EventResult> m_future;
+    };
 }
+#endif
+#endif
 
 #endif
@@ -0,0 +1,667 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <QtCore/QFile>
+#include <QtCore/QPointer>
+#include <QtCore/QThread>
+#include <QtDBus/QDBusPendingCallWatcher>
+#include <QtDBus/QDBusReply>
+
+#include "ngfclient.h"
+
+#include "testbase.h"
+#include "moc_testbase.cpp"
+
+/*
+ * Every heap allocation made by the benchmark process is counted, see
+ * benchmarkPlayAllocations().
+ */
+static std::atomic<int> allocationCount(0);
+
+void *operator new(std::size_t size)
+{
+    ++allocationCount;
+
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+namespace Ngf {
+namespace Tests {
+
+class BmClient : public TestBase
+{
+    Q_OBJECT
+
+    enum {
+        POPULATE_TIMEOUT = 30000, // [ms]
+        IDLE_CLIENT_COUNT = 10,
+        STATUS_CYCLES = 50,
+        FOREIGN_STATUSES = 5, // Sent by another service each cycle
+        BLOCKED_CYCLES = 20,
+        BLOCK_TIME = 50, // [ms]
+        ALLOCATION_CYCLES = 100,
+        SHARED_CLIENT_COUNT = 10,
+        NOISE_CYCLES = 20,
+        NOISE_SIGNALS = 500, // Sent before each play
+        NOISE_PAYLOAD = 4096, // [bytes]
+    };
+
+public:
+    BmClient();
+
+    static int clientMain(const QStringList &arguments);
+
+public slots:
+    void noiseReceived();
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchmarkLookupById_data();
+    void benchmarkLookupById();
+    void benchmarkLookupByName_data();
+    void benchmarkLookupByName();
+    void benchmarkPlayStopCycle_data();
+    void benchmarkPlayStopCycle();
+    void benchmarkIdleClientWakeups_data();
+    void benchmarkIdleClientWakeups();
+    void benchmarkTransport_data();
+    void benchmarkTransport();
+    void benchmarkBlockedClientThread_data();
+    void benchmarkBlockedClientThread();
+    void benchmarkPlayAllocations_data();
+    void benchmarkPlayAllocations();
+    void benchmarkSharedClients_data();
+    void benchmarkSharedClients();
+    void benchmarkOwnerLookup_data();
+    void benchmarkOwnerLookup();
+    void benchmarkCompetingTraffic_data();
+    void benchmarkCompetingTraffic();
+
+private:
+    static void addEventCountRows();
+    void populate(int count);
+    void playStopCycle(Client *client, bool prepared);
+    static QString idleClientService(qint64 pid);
+    static qint64 voluntaryContextSwitches(qint64 pid);
+
+    QPointer<Client> m_client;
+    QList<quint32> m_ids;
+    int m_noiseCount;
+};
+
+/*
+ * Plays an event from a worker thread and notes when it did so.
+ */
+class PlayThread : public QThread
+{
+public:
+    PlayThread(Client *client, const QString &event)
+        : client(client), event(event), id(0), playTime(0) {}
+
+    void run()
+    {
+        playTime = TestBase::monotonicTime();
+        id = client->play(event);
+    }
+
+    Client *client;
+    QString event;
+    quint32 id;
+    qint64 playTime; // [ms]
+};
+
+} // namespace Tests
+} // namespace Ngf
+
+using namespace Ngf::Tests;
+
+/*
+ * \class Ngf::Tests::BmClient
+ */
+
+BmClient::BmClient()
+    : m_noiseCount(0)
+{
+}
+
+void BmClient::initTestCase()
+{
+    QVERIFY(waitForService(service()));
+
+    m_client = new Client(this);
+
+    // Populating plays up to a thousand events at once, the replies may take a while
+    m_client->setReplyTimeout(POPULATE_TIMEOUT);
+
+    QVERIFY(m_client->connect());
+    QVERIFY(m_client->isConnected());
+}
+
+void BmClient::cleanupTestCase()
+{
+    delete m_client;
+}
+
+void BmClient::addEventCountRows()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("1 event") << 1;
+    QTest::newRow("10 events") << 10;
+    QTest::newRow("100 events") << 100;
+    QTest::newRow("1000 events") << 1000;
+}
+
+/*
+ * Plays events until the client tracks at least count of them. Events are left playing,
+ * so the event table only grows between benchmark rows.
+ */
+void BmClient::populate(int count)
+{
+    SignalSpy eventPlayingSpy(m_client, SIGNAL(eventPlaying(quint32)));
+    const int expected = count - m_ids.count();
+
+    while (m_ids.count() < count) {
+        const quint32 id = m_client->play(QString("bm-event-%1").arg(m_ids.count()));
+        QVERIFY(id > 0);
+        m_ids.append(id);
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(eventPlayingSpy.count(), qMax(expected, 0), POPULATE_TIMEOUT);
+}
+
+void BmClient::benchmarkLookupById_data()
+{
+    addEventCountRows();
+}
+
+void BmClient::benchmarkLookupById()
+{
+    QFETCH(int, count);
+
+    populate(count);
+    if (QTest::currentTestFailed())
+        return;
+
+    // The newest event is the last one a linear scan would reach. It is already playing,
+    // so resume() only costs the lookup and doesn't send anything to the daemon.
+    const quint32 id = m_ids.last();
+
+    QBENCHMARK {
+        m_client->resume(id);
+    }
+}
+
+void BmClient::benchmarkLookupByName_data()
+{
+    addEventCountRows();
+}
+
+void BmClient::benchmarkLookupByName()
+{
+    QFETCH(int, count);
+
+    populate(count);
+    if (QTest::currentTestFailed())
+        return;
+
+    const QString name = QString("bm-event-%1").arg(m_ids.count() - 1);
+
+    QBENCHMARK {
+        m_client->resume(name);
+    }
+}
+
+void BmClient::playStopCycle(Client *client, bool prepared)
+{
+    static QVariantMap properties;
+    static PreparedEvent preparedEvent;
+
+    if (properties.isEmpty()) {
+        properties["media.audio"] = false;
+        properties["media.vibra"] = true;
+        properties["haptic.type"] = "touch";
+        preparedEvent = m_client->prepare("bm-cycle", properties);
+    }
+
+    SignalSpy eventPlayingSpy(client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(client, SIGNAL(eventCompleted(quint32)));
+
+    const quint32 id = prepared
+            ? client->play(preparedEvent)
+            : client->play("bm-cycle", properties);
+    QVERIFY(id > 0);
+    QTRY_COMPARE_WITH_TIMEOUT(eventPlayingSpy.count(), 1, (int)SIGNAL_WAIT_TIMEOUT);
+
+    QVERIFY(client->stop(id));
+    QTRY_COMPARE_WITH_TIMEOUT(eventCompletedSpy.count(), 1, (int)SIGNAL_WAIT_TIMEOUT);
+}
+
+void BmClient::benchmarkPlayStopCycle_data()
+{
+    QTest::addColumn<bool>("prepared");
+
+    QTest::newRow("by name") << false;
+    QTest::newRow("prepared") << true;
+}
+
+void BmClient::benchmarkPlayStopCycle()
+{
+    QFETCH(bool, prepared);
+
+    // Warm up, the event table may need to grow once for the cycled event
+    playStopCycle(m_client, prepared);
+    if (QTest::currentTestFailed())
+        return;
+
+    const QVariantMap before = m_client->statistics();
+
+    QBENCHMARK {
+        playStopCycle(m_client, prepared);
+    }
+
+    // Steady state play/complete cycles reuse the event table storage
+    const QVariantMap after = m_client->statistics();
+    QCOMPARE(after.value("eventCapacity"), before.value("eventCapacity"));
+    QCOMPARE(after.value("eventTableBytes"), before.value("eventTableBytes"));
+}
+
+QString BmClient::idleClientService(qint64 pid)
+{
+    return QString("com.nokia.NonGraphicFeedback1.Tests.IdleClient%1").arg(pid);
+}
+
+/*
+ * Client process which connects and then just waits. Its service is registered once
+ * the client has subscribed to event status. In the unrestricted mode the process
+ * subscribes with the match rule clients used before it was restricted to NGF daemon.
+ */
+int BmClient::clientMain(const QStringList &arguments)
+{
+    Client client;
+    BmClient receiver;
+
+    client.setSubscribedWhenIdle(arguments.value(0) != "lazy");
+
+    if (arguments.value(0) == "unrestricted") {
+        if (!bus().connect(QString(), path(), interface(), "Status",
+                           &receiver, SLOT(noiseReceived())))
+            return 1;
+    } else if (!client.connect()) {
+        return 1;
+    }
+
+    if (!bus().registerService(idleClientService(QCoreApplication::applicationPid())))
+        return 1;
+
+    return QCoreApplication::exec();
+}
+
+qint64 BmClient::voluntaryContextSwitches(qint64 pid)
+{
+    QFile status(QString("/proc/%1/status").arg(pid));
+
+    if (!status.open(QIODevice::ReadOnly))
+        return -1;
+
+    const QByteArray key("voluntary_ctxt_switches:");
+
+    while (!status.atEnd()) {
+        const QByteArray line = status.readLine();
+        if (line.startsWith(key))
+            return line.mid(key.size()).trimmed().toLongLong();
+    }
+
+    return -1;
+}
+
+void BmClient::benchmarkIdleClientWakeups_data()
+{
+    QTest::addColumn<QString>("mode");
+
+    QTest::newRow("any sender") << "unrestricted";
+    QTest::newRow("subscribed when idle") << "always";
+    QTest::newRow("subscribed while playing") << "lazy";
+}
+
+/*
+ * Plays events while other client processes sit idle, and reports how many times the
+ * idle processes were woken up in total. Another service sends Status signals of the
+ * same interface meanwhile, which only the match rule without a sender lets through.
+ */
+void BmClient::benchmarkIdleClientWakeups()
+{
+    QFETCH(QString, mode);
+
+    const QString foreignConnection = "bm-client-foreign";
+    QList<QProcess *> clients;
+
+    for (int i = 0; i < IDLE_CLIENT_COUNT; ++i) {
+        QProcess *client = new QProcess(this);
+        client->setProcessChannelMode(QProcess::ForwardedChannels);
+        client->start(QCoreApplication::applicationFilePath(),
+                      QStringList() << "--client" << mode);
+        clients.append(client);
+    }
+
+    QDBusConnection foreign = QDBusConnection::connectToBus(QDBusConnection::SystemBus,
+                                                            foreignConnection);
+    QDBusMessage foreignStatus = QDBusMessage::createSignal(path(), interface(), "Status");
+    foreignStatus << quint32(0) << quint32(0);
+
+    bool ready = true;
+    for (int i = 0; i < clients.count() && ready; ++i)
+        ready = clients.at(i)->waitForStarted() && waitForService(idleClientService(clients.at(i)->processId()));
+
+    qint64 wakeups = 0;
+
+    if (ready) {
+        // Let the clients settle down after starting
+        QTest::qWait(500);
+
+        QList<qint64> before;
+        for (int i = 0; i < clients.count(); ++i)
+            before.append(voluntaryContextSwitches(clients.at(i)->processId()));
+
+        for (int i = 0; i < STATUS_CYCLES && !QTest::currentTestFailed(); ++i) {
+            for (int j = 0; j < FOREIGN_STATUSES; ++j)
+                foreign.send(foreignStatus);
+            playStopCycle(m_client, false);
+        }
+
+        // Give the clients time to handle what was delivered to them
+        QTest::qWait(500);
+
+        for (int i = 0; i < clients.count(); ++i)
+            wakeups += voluntaryContextSwitches(clients.at(i)->processId()) - before.at(i);
+    }
+
+    for (int i = 0; i < clients.count(); ++i) {
+        clients.at(i)->terminate();
+        clients.at(i)->waitForFinished();
+    }
+    qDeleteAll(clients);
+    QDBusConnection::disconnectFromBus(foreignConnection);
+
+    QVERIFY(ready);
+
+    QTest::setBenchmarkResult(wakeups, QTest::Events);
+}
+
+void BmClient::benchmarkTransport_data()
+{
+    QTest::addColumn<bool>("peer");
+
+    QTest::newRow("system bus") << false;
+    QTest::newRow("peer") << true;
+}
+
+/*
+ * Compares play/stop round trips through the bus daemon to ones made straight to the
+ * mock daemon, which stands in for a private NGFD socket.
+ */
+void BmClient::benchmarkTransport()
+{
+    QFETCH(bool, peer);
+
+    QDBusInterface mockService(service(), path(), interface(), bus());
+    QDBusReply<QString> address = mockService.call("mock_peerAddress");
+    QVERIFY(address.isValid());
+
+    Client client;
+    if (peer)
+        client.setPeerAddress(address.value());
+    else
+        client.setPeerAddress(QString());
+
+    QVERIFY(client.connect());
+    QCOMPARE(client.statistics().value("transport").toString(),
+             QString(peer ? "peer" : "bus"));
+
+    playStopCycle(&client, true);
+    if (QTest::currentTestFailed())
+        return;
+
+    QBENCHMARK {
+        playStopCycle(&client, true);
+    }
+}
+
+void BmClient::benchmarkBlockedClientThread_data()
+{
+    QTest::addColumn<bool>("threaded");
+
+    QTest::newRow("client thread") << false;
+    QTest::newRow("dispatch thread") << true;
+}
+
+/*
+ * Measures how long it takes for an event played from a worker thread to reach the mock
+ * daemon while the client thread is blocked.
+ */
+void BmClient::benchmarkBlockedClientThread()
+{
+    QFETCH(bool, threaded);
+
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    Client client;
+    client.setThreadedDispatch(threaded);
+    QVERIFY(client.connect());
+
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+    qint64 latency = 0;
+
+    for (int i = 0; i < BLOCKED_CYCLES; ++i) {
+        PlayThread player(&client, "bm-blocked");
+        player.start();
+
+        // Stall the client thread like a long layout pass would
+        QThread::msleep(BLOCK_TIME);
+        QVERIFY(player.wait(SIGNAL_WAIT_TIMEOUT));
+
+        QTRY_COMPARE_WITH_TIMEOUT(eventPlayingSpy.count(), i + 1, (int)SIGNAL_WAIT_TIMEOUT);
+
+        QDBusReply<qint64> played = mockService.call("mock_lastPlayTime");
+        QVERIFY(played.isValid());
+        latency += played.value() - player.playTime;
+
+        QVERIFY(client.stop(player.id));
+        QTRY_COMPARE_WITH_TIMEOUT(eventCompletedSpy.count(), i + 1, (int)SIGNAL_WAIT_TIMEOUT);
+    }
+
+    QTest::setBenchmarkResult(qreal(latency) / BLOCKED_CYCLES, QTest::WalltimeMilliseconds);
+}
+
+void BmClient::benchmarkPlayAllocations_data()
+{
+    benchmarkPlayStopCycle_data();
+}
+
+/*
+ * Reports heap allocations made by the test process per play/stop cycle, including what
+ * QtDBus allocates for sending the calls and for delivering replies and signals.
+ */
+void BmClient::benchmarkPlayAllocations()
+{
+    QFETCH(bool, prepared);
+
+    playStopCycle(m_client, prepared);
+    if (QTest::currentTestFailed())
+        return;
+
+    const int receivers = m_client->statistics().value("replyReceivers").toInt();
+    const int before = allocationCount;
+
+    for (int i = 0; i < ALLOCATION_CYCLES && !QTest::currentTestFailed(); ++i)
+        playStopCycle(m_client, prepared);
+
+    const int allocations = allocationCount - before;
+
+    QCOMPARE(m_client->statistics().value("pendingReplies").toInt(), 0);
+
+    // Whatever QtDBus allocates, the client keeps receiving replies with the same objects
+    QCOMPARE(m_client->statistics().value("replyReceivers").toInt(), receivers);
+
+    QTest::setBenchmarkResult(qreal(allocations) / ALLOCATION_CYCLES, QTest::Events);
+}
+
+void BmClient::benchmarkSharedClients_data()
+{
+    QTest::addColumn<int>("clientCount");
+
+    QTest::newRow("1 client") << 1;
+    QTest::newRow("10 clients") << (int)SHARED_CLIENT_COUNT;
+}
+
+/*
+ * Play/stop cycles with other connected clients in the same thread. The clients share
+ * one status subscription, so the Status signals of the cycles are received once and
+ * dispatched to the playing client only.
+ */
+void BmClient::benchmarkSharedClients()
+{
+    QFETCH(int, clientCount);
+
+    const int shared = m_client->statistics().value("sharedClients").toInt();
+    QList<Client *> clients;
+
+    for (int i = 1; i < clientCount; ++i) {
+        Client *client = new Client;
+        clients.append(client);
+        QVERIFY(client->connect());
+    }
+
+    QCOMPARE(m_client->statistics().value("sharedClients").toInt(), shared + clientCount - 1);
+
+    playStopCycle(m_client, false);
+
+    if (!QTest::currentTestFailed()) {
+        QBENCHMARK {
+            playStopCycle(m_client, false);
+        }
+    }
+
+    qDeleteAll(clients);
+}
+
+void BmClient::benchmarkOwnerLookup_data()
+{
+    QTest::addColumn<bool>("eager");
+
+    QTest::newRow("lazy") << false;
+    QTest::newRow("eager") << true;
+}
+
+/*
+ * Time connect() takes, including the unique name lookup of NGF daemon when eager. The
+ * lazy lookup is made once per thread and overlaps with whatever the client does next.
+ */
+void BmClient::benchmarkOwnerLookup()
+{
+    QFETCH(bool, eager);
+
+    QBENCHMARK {
+        Client client;
+        client.setEagerOwnerLookup(eager);
+        QVERIFY(client.connect());
+    }
+
+    QVERIFY(!m_client->statistics().value("serviceOwner").toString().isEmpty());
+}
+
+void BmClient::noiseReceived()
+{
+    ++m_noiseCount;
+}
+
+void BmClient::benchmarkCompetingTraffic_data()
+{
+    QTest::addColumn<bool>("privateConnection");
+    QTest::addColumn<bool>("threaded");
+
+    QTest::newRow("shared connection") << false << false;
+    QTest::newRow("private connection") << true << false;
+    QTest::newRow("private connection, dispatch thread") << true << true;
+}
+
+/*
+ * Measures how long it takes for a play to be reported playing while the application
+ * receives a flood of signals from another service on its system bus connection.
+ */
+void BmClient::benchmarkCompetingTraffic()
+{
+    QFETCH(bool, privateConnection);
+    QFETCH(bool, threaded);
+
+    const QString noisePath = "/com/nokia/NonGraphicFeedback1/Tests/Noise";
+    const QString noiseInterface = "com.nokia.NonGraphicFeedback1.Tests.Noise";
+    const QString noiseConnection = "bm-client-noise";
+
+    Client client;
+    client.setPrivateConnection(privateConnection);
+    client.setThreadedDispatch(threaded);
+    QVERIFY(client.connect());
+    QCOMPARE(client.statistics().value("transport").toString(),
+             QString(privateConnection ? "private" : "bus"));
+
+    // Some other part of the application follows a busy service
+    m_noiseCount = 0;
+    QVERIFY(bus().connect(QString(), noisePath, noiseInterface, "Changed",
+                          this, SLOT(noiseReceived())));
+
+    QDBusConnection noise = QDBusConnection::connectToBus(QDBusConnection::SystemBus,
+                                                          noiseConnection);
+    QVERIFY(noise.isConnected());
+
+    QDBusMessage changed = QDBusMessage::createSignal(noisePath, noiseInterface, "Changed");
+    changed << QByteArray(NOISE_PAYLOAD, 'x');
+
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+    QElapsedTimer timer;
+    qint64 latency = 0;
+
+    for (int i = 0; i < NOISE_CYCLES && !QTest::currentTestFailed(); ++i) {
+        for (int j = 0; j < NOISE_SIGNALS; ++j)
+            noise.send(changed);
+
+        eventPlayingSpy.clear();
+        eventCompletedSpy.clear();
+
+        timer.start();
+        const quint32 id = client.play("bm-competing");
+        QVERIFY(id > 0);
+        QVERIFY(waitForSignal(&eventPlayingSpy));
+        latency += timer.nsecsElapsed();
+
+        QVERIFY(client.stop(id));
+        QVERIFY(waitForSignal(&eventCompletedSpy));
+    }
+
+    bus().disconnect(QString(), noisePath, noiseInterface, "Changed",
+                     this, SLOT(noiseReceived()));
+    QDBusConnection::disconnectFromBus(noiseConnection);
+
+    // Noise must have reached the application for the comparison to mean anything
+    QVERIFY(m_noiseCount > 0);
+
+    QTest::setBenchmarkResult(qreal(latency) / NOISE_CYCLES / 1000000,
+                              QTest::WalltimeMilliseconds);
+}
+
+TEST_MAIN(BmClient)
+
+#include "bm_client.moc"
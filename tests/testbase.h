@@ -5,11 +5,14 @@
 #include <QtCore/QMetaProperty>
 #include <QtCore/QObject>
 #include <QtCore/QPointer>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QProcess>
 #include <QtCore/QTimer>
 #include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusContext>
 #include <QtDBus/QDBusInterface>
 #include <QtDBus/QDBusConnectionInterface>
+#include <QtDBus/QDBusServer>
 #include <QtDBus/QDBusServiceWatcher>
 #include <QtTest/QSignalSpy>
 #include <QTest>
@@ -60,9 +63,15 @@ protected:
     static QString clientDBusProperty2QtProperty(const QString &property);
     static QVariantMap defaultClientProperties();
     static QVariantMap alternateClientProperties();
+
+public:
+    // Entry point of helper client processes started with --client, see TEST_MAIN
+    static int clientMain(const QStringList &arguments);
+
+    static qint64 monotonicTime(); // [ms], comparable between processes
 };
 
-class TestBase::NgfdMock : public QObject
+class TestBase::NgfdMock : public QObject, protected QDBusContext
 {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", "com.nokia.NonGraphicFeedback1")
@@ -91,7 +100,14 @@ public:
     Q_SCRIPTABLE void mock_stop(const QString &event, const QDBusMessage &message);
     Q_SCRIPTABLE void mock_fail(const QString &event, const QDBusMessage &message);
     Q_SCRIPTABLE void mock_failNextPlay();
+    Q_SCRIPTABLE void mock_delayNextPlay(int msec);
+    Q_SCRIPTABLE void mock_completeNextPlaysEarly(int count);
     Q_SCRIPTABLE void mock_disconnectForAWhile(const QDBusMessage &message);
+    Q_SCRIPTABLE void mock_restart(const QDBusMessage &message);
+    Q_SCRIPTABLE void mock_unregister(const QDBusMessage &message);
+    Q_SCRIPTABLE void mock_register(const QDBusMessage &message);
+    Q_SCRIPTABLE QString mock_peerAddress() const;
+    Q_SCRIPTABLE qint64 mock_lastPlayTime() const;
 
     static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message);
     static void installMsgHandler();
@@ -104,12 +120,22 @@ signals:
     Q_SCRIPTABLE void mock_pauseCalled(quint32 event, bool pause);
     Q_SCRIPTABLE void mock_stopCalled(quint32 event);
 
+private slots:
+    void peerConnected(const QDBusConnection &connection);
+    void sendDelayedReply();
+
 private:
     int m_maxId;
     bool m_failNextPlay;
+    int m_nextPlayDelay; // [ms]
+    int m_earlyCompletions; // Plays to complete before replying to them
+    QMultiMap<qint64, QPair<QDBusConnection, QDBusMessage> > m_delayedReplies; // by due time
     QMap<QString, QPair<quint32, QVariantMap> > m_events;
     QMap<quint32, QString> m_eventId2Name;
     QSet<QString> m_paused;
+    qint64 m_lastPlayTime; // [ms] see monotonicTime()
+    QDBusServer *m_peerServer; // Stand-in for a private NGFD socket
+    QList<QDBusConnection> m_peers;
 };
 
 /*
@@ -154,6 +180,13 @@ inline TestBase::TestBase()
     qRegisterMetaType<QDBusPendingCallWatcher *>(); // needed by waitForSignal
 }
 
+inline int TestBase::clientMain(const QStringList &arguments)
+{
+    Q_UNUSED(arguments);
+    qFatal("This test doesn't start client processes");
+    return 1;
+}
+
 inline QByteArray TestBase::notifySignal(const QObject &object, const char *property)
 {
     Q_ASSERT(object.metaObject()->indexOfProperty(property) != -1);
@@ -226,6 +259,14 @@ inline bool TestBase::waitForService(const QString &serviceName)
     return waitForSignal(&spy);
 }
 
+inline qint64 TestBase::monotonicTime()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    return timer.msecsSinceReference();
+}
+
 inline void TestBase::createTestPropertyData(const QVariantMap &expected,
         QString (*dbusProperty2QtProperty)(const QString &))
 {
@@ -360,7 +401,11 @@ inline QVariantMap TestBase::alternateClientProperties()
 
 inline TestBase::NgfdMock::NgfdMock()
     : m_maxId(0),
-      m_failNextPlay(false)
+      m_failNextPlay(false),
+      m_nextPlayDelay(0),
+      m_earlyCompletions(0),
+      m_lastPlayTime(0),
+      m_peerServer(new QDBusServer("unix:tmpdir=/tmp", this))
 {
     if (!bus().registerObject(path(), this, QDBusConnection::ExportScriptableContents)) {
         qFatal("Failed to register mock D-Bus object at path '%s': '%s'",
@@ -371,6 +416,14 @@ inline TestBase::NgfdMock::NgfdMock()
         qFatal("Failed to register mock D-Bus service '%s': '%s'",
                 qPrintable(service()), qPrintable(bus().lastError().message()));
     }
+
+    if (!m_peerServer->isConnected()) {
+        qFatal("Failed to listen for mock D-Bus peers: '%s'",
+                qPrintable(m_peerServer->lastError().message()));
+    }
+
+    connect(m_peerServer, SIGNAL(newConnection(QDBusConnection)),
+            this, SLOT(peerConnected(QDBusConnection)));
 }
 
 inline quint32 TestBase::NgfdMock::Play(const QString &event, const QVariantMap &properties,
@@ -378,10 +431,12 @@ inline quint32 TestBase::NgfdMock::Play(const QString &event, const QVariantMap
 {
     Q_ASSERT(!m_events.contains(event));
 
+    m_lastPlayTime = monotonicTime();
+
     if (m_failNextPlay) {
         m_failNextPlay = false;
 
-        bus().send(message.createErrorReply(QDBusError::InvalidArgs, "mock_failNextPlay-requested"));
+        connection().send(message.createErrorReply(QDBusError::InvalidArgs, "mock_failNextPlay-requested"));
 
         emit mock_playCalled(event, properties);
 
@@ -390,10 +445,30 @@ inline quint32 TestBase::NgfdMock::Play(const QString &event, const QVariantMap
 
     const quint32 id = ++m_maxId;
 
+    if (m_earlyCompletions > 0) {
+        --m_earlyCompletions;
+
+        // Status goes out first, and D-Bus keeps messages from one sender in order
+        emit Status(id, StatusEventCompleted);
+        connection().send(message.createReply(id));
+
+        emit mock_playCalled(event, properties);
+
+        return 0;
+    }
+
     m_events[event] = qMakePair(id, properties);
     m_eventId2Name[id] = event;
 
-    bus().send(message.createReply(id));
+    if (m_nextPlayDelay > 0) {
+        message.setDelayedReply(true);
+        m_delayedReplies.insert(monotonicTime() + m_nextPlayDelay,
+                                qMakePair(connection(), message.createReply(id)));
+        QTimer::singleShot(m_nextPlayDelay, this, SLOT(sendDelayedReply()));
+        m_nextPlayDelay = 0;
+    } else {
+        connection().send(message.createReply(id));
+    }
 
     emit mock_playCalled(event, properties);
 
@@ -403,11 +478,11 @@ inline quint32 TestBase::NgfdMock::Play(const QString &event, const QVariantMap
 inline void TestBase::NgfdMock::Pause(quint32 event, bool pause, const QDBusMessage &message)
 {
     if (!m_eventId2Name.contains(event)) {
-        bus().send(message.createErrorReply(QDBusError::InvalidArgs, "Unknown event"));
+        connection().send(message.createErrorReply(QDBusError::InvalidArgs, "Unknown event"));
         return;
     }
 
-    bus().send(message.createReply());
+    connection().send(message.createReply());
 
     if (pause) {
         m_paused.insert(m_eventId2Name.value(event));
@@ -423,11 +498,11 @@ inline void TestBase::NgfdMock::Pause(quint32 event, bool pause, const QDBusMess
 inline void TestBase::NgfdMock::Stop(quint32 event, const QDBusMessage &message)
 {
     if (!m_eventId2Name.contains(event)) {
-        bus().send(message.createErrorReply(QDBusError::InvalidArgs, "Unknown event"));
+        connection().send(message.createErrorReply(QDBusError::InvalidArgs, "Unknown event"));
         return;
     }
 
-    bus().send(message.createReply());
+    connection().send(message.createReply());
 
     m_paused.remove(m_eventId2Name.value(event));
     m_events.remove(m_eventId2Name.value(event));
@@ -468,11 +543,11 @@ inline bool TestBase::NgfdMock::mock_isPaused(const QString &event) const
 inline void TestBase::NgfdMock::mock_stop(const QString &event, const QDBusMessage &message)
 {
     if (!m_events.contains(event)) {
-        bus().send(message.createErrorReply(QDBusError::InvalidArgs, "Unknown event"));
+        connection().send(message.createErrorReply(QDBusError::InvalidArgs, "Unknown event"));
         return;
     }
 
-    bus().send(message.createReply());
+    connection().send(message.createReply());
 
     const quint32 eventId = m_eventId2Name.key(event);
 
@@ -486,11 +561,11 @@ inline void TestBase::NgfdMock::mock_stop(const QString &event, const QDBusMessa
 inline void TestBase::NgfdMock::mock_fail(const QString &event, const QDBusMessage &message)
 {
     if (!m_events.contains(event)) {
-        bus().send(message.createErrorReply(QDBusError::InvalidArgs, "Unknown event"));
+        connection().send(message.createErrorReply(QDBusError::InvalidArgs, "Unknown event"));
         return;
     }
 
-    bus().send(message.createReply());
+    connection().send(message.createReply());
 
     const quint32 eventId = m_eventId2Name.key(event);
 
@@ -506,9 +581,26 @@ inline void TestBase::NgfdMock::mock_failNextPlay()
     m_failNextPlay = true;
 }
 
+inline void TestBase::NgfdMock::mock_delayNextPlay(int msec)
+{
+    m_nextPlayDelay = msec;
+}
+
+inline void TestBase::NgfdMock::mock_completeNextPlaysEarly(int count)
+{
+    m_earlyCompletions = count;
+}
+
+inline void TestBase::NgfdMock::sendDelayedReply()
+{
+    // Shorter delays given later are replied first
+    const QPair<QDBusConnection, QDBusMessage> reply = m_delayedReplies.take(m_delayedReplies.firstKey());
+    QDBusConnection(reply.first).send(reply.second);
+}
+
 inline void TestBase::NgfdMock::mock_disconnectForAWhile(const QDBusMessage &message)
 {
-    bus().send(message.createReply());
+    connection().send(message.createReply());
 
     if (!bus().unregisterService(service())) {
         qFatal("Failed to unregister mock D-Bus service '%s': '%s'",
@@ -521,6 +613,59 @@ inline void TestBase::NgfdMock::mock_disconnectForAWhile(const QDBusMessage &mes
     }
 }
 
+inline void TestBase::NgfdMock::mock_restart(const QDBusMessage &message)
+{
+    // Restarted daemon has lost all events it was playing
+    m_events.clear();
+    m_eventId2Name.clear();
+    m_paused.clear();
+
+    mock_disconnectForAWhile(message);
+}
+
+// Reachable through its unique name only until registered again
+inline void TestBase::NgfdMock::mock_unregister(const QDBusMessage &message)
+{
+    connection().send(message.createReply());
+
+    if (!bus().unregisterService(service())) {
+        qFatal("Failed to unregister mock D-Bus service '%s': '%s'",
+            qPrintable(service()), qPrintable(bus().lastError().message()));
+    }
+}
+
+inline void TestBase::NgfdMock::mock_register(const QDBusMessage &message)
+{
+    connection().send(message.createReply());
+
+    if (!bus().registerService(service())) {
+        qFatal("Failed to register mock D-Bus service: '%s' '%s'",
+            qPrintable(service()), qPrintable(bus().lastError().message()));
+    }
+}
+
+inline QString TestBase::NgfdMock::mock_peerAddress() const
+{
+    return m_peerServer->address();
+}
+
+inline qint64 TestBase::NgfdMock::mock_lastPlayTime() const
+{
+    return m_lastPlayTime;
+}
+
+inline void TestBase::NgfdMock::peerConnected(const QDBusConnection &connection)
+{
+    QDBusConnection peer(connection);
+
+    if (!peer.registerObject(path(), this, QDBusConnection::ExportScriptableContents)) {
+        qFatal("Failed to register mock D-Bus object for peer: '%s'",
+                qPrintable(peer.lastError().message()));
+    }
+
+    m_peers.append(peer);
+}
+
 #define TEST_MAIN(TestClass)                                                \
     int main(int argc, char *argv[])                                        \
     {                                                                       \
@@ -536,6 +681,10 @@ inline void TestBase::NgfdMock::mock_disconnectForAWhile(const QDBusMessage &mes
             Ngf::Tests::TestBase::NgfdMock mock;                            \
                                                                             \
             return app.exec();                                              \
+        } else if (argc >= 2 && argv[1] == QLatin1String("--client")) {     \
+            QCoreApplication app(argc, argv);                               \
+                                                                            \
+            return TestClass::clientMain(app.arguments().mid(2));           \
         } else {                                                            \
             QCoreApplication app(argc, argv);                               \
                                                                             \
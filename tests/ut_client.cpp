@@ -1,4 +1,5 @@
 #include <QtCore/QPointer>
+#include <QtCore/QThread>
 #include <QtDBus/QDBusPendingCallWatcher>
 #include <QtDBus/QDBusReply>
 
@@ -28,11 +29,79 @@ private slots:
     void testPlayFail();
     void testConnectionStatus();
     void testFastPlayStop();
+    void testPlayPrepared();
+    void testPlayDetached();
+    void testBatch();
+    void testCoalesceStateRequests();
+    void testSubscribedWhenIdle();
+    void testPeerConnection();
+    void testPlayFromThread();
+    void testThreadedDispatch();
+    void testReplyTimeout();
+    void testInFlightLimit();
+    void testRateLimit();
+    void testFailureCache();
+    void testEarlyStatus();
+    void testEventSweeper();
+    void testEventState();
+    void testEventHandle();
+    void testPlayAsync();
+    void testSharedStatus();
+    void testRecovery();
+    void testOfflineQueue();
+    void testServiceOwner();
+    void testPrivateConnection();
+    void testStopBeforeDelete();
+    void testRepliesOutOfOrder();
+    void testHandleStateOffThread();
+    void testDeleteClientOnStatus();
 
 private:
     QPointer<Client> m_client;
 };
 
+class PlayThread : public QThread
+{
+public:
+    PlayThread(Client *client) : client(client), id(0) {}
+
+    void run()
+    {
+        id = client->play("a-threaded-event");
+    }
+
+    Client *client;
+    quint32 id;
+};
+
+class HandleStateThread : public QThread
+{
+public:
+    HandleStateThread(const EventHandle *handle) : handle(handle), state(Client::EventUnknown) {}
+
+    void run()
+    {
+        state = handle->state();
+    }
+
+    const EventHandle *handle;
+    Client::EventState state;
+};
+
+class StopThread : public QThread
+{
+public:
+    StopThread(Client *client, quint32 id) : client(client), id(id) {}
+
+    void run()
+    {
+        client->stop(id);
+    }
+
+    Client *client;
+    quint32 id;
+};
+
 } // namespace Tests
 } // namespace Ngf
 
@@ -253,6 +322,1079 @@ void UtClient::testFastPlayStop()
     QCOMPARE(eventCompletedSpy.at(0).at(0).toUInt(), 4u);
 }
 
+void UtClient::testPlayPrepared()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    QVariantMap properties;
+    properties["foo"] = "fooval";
+    properties["bar"] = 42;
+
+    PreparedEvent prepared = m_client->prepare("an-event", properties);
+    QVERIFY(prepared.isValid());
+    QCOMPARE(prepared.event(), QString("an-event"));
+    QCOMPARE(prepared.properties(), properties);
+
+    QVERIFY(!PreparedEvent().isValid());
+    QCOMPARE(m_client->play(PreparedEvent()), 0u);
+
+    for (int i = 0; i < 2; ++i) {
+        SignalSpy playCalledSpy(&mockService, SIGNAL(mock_playCalled(QString,QVariantMap)));
+        SignalSpy eventCompletedSpy(m_client, SIGNAL(eventCompleted(quint32)));
+
+        quint32 id = m_client->play(prepared);
+        QVERIFY(id > 0);
+
+        QVERIFY(waitForSignal(&playCalledSpy));
+        QCOMPARE(playCalledSpy.count(), 1);
+        QCOMPARE(playCalledSpy.at(0).at(0).toString(), QString("an-event"));
+        QCOMPARE(playCalledSpy.at(0).at(1).toMap(), properties);
+
+        QVERIFY(m_client->stop(id));
+
+        QVERIFY(waitForSignal(&eventCompletedSpy));
+        QCOMPARE(eventCompletedSpy.count(), 1);
+        QCOMPARE(eventCompletedSpy.at(0).at(0).toUInt(), id);
+    }
+}
+
+void UtClient::testPlayDetached()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    SignalSpy playCalledSpy(&mockService, SIGNAL(mock_playCalled(QString,QVariantMap)));
+    SignalSpy eventPlayingSpy(m_client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventFailedSpy(m_client, SIGNAL(eventFailed(quint32)));
+
+    const QVariantMap before = m_client->statistics();
+
+    QVariantMap properties;
+    properties["foo"] = "fooval";
+
+    QVERIFY(m_client->playDetached("a-detached-event", properties));
+
+    QVERIFY(waitForSignal(&playCalledSpy));
+    QCOMPARE(playCalledSpy.count(), 1);
+    QCOMPARE(playCalledSpy.at(0).at(0).toString(), QString("a-detached-event"));
+    QCOMPARE(playCalledSpy.at(0).at(1).toMap(), properties);
+
+    const QVariantMap after = m_client->statistics();
+    QCOMPARE(after.value("detachedPlays").toULongLong(),
+             before.value("detachedPlays").toULongLong() + 1);
+    QCOMPARE(after.value("plays"), before.value("plays"));
+    QCOMPARE(after.value("events"), before.value("events"));
+
+    mockService.call("mock_stop", "a-detached-event");
+
+    QTest::qWait(100);
+    QCOMPARE(eventPlayingSpy.count(), 0);
+    QCOMPARE(eventFailedSpy.count(), 0);
+}
+
+void UtClient::testBatch()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    SignalSpy playCalledSpy(&mockService, SIGNAL(mock_playCalled(QString,QVariantMap)));
+    SignalSpy eventPlayingSpy(m_client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(m_client, SIGNAL(eventCompleted(quint32)));
+    SignalSpy batchFinishedSpy(m_client, SIGNAL(batchFinished(quint32)));
+
+    const quint32 batch = m_client->beginBatch();
+    QVERIFY(batch > 0);
+
+    const quint32 first = m_client->play("a-batch-event");
+    const quint32 second = m_client->play("another-batch-event");
+    QVERIFY(first > 0);
+    QVERIFY(second > first);
+
+    // Nothing is sent before the batch is committed
+    QTest::qWait(100);
+    QCOMPARE(playCalledSpy.count(), 0);
+
+    QCOMPARE(m_client->commitBatch(), QList<quint32>() << first << second);
+
+    QVERIFY(waitForSignal(&batchFinishedSpy));
+    QCOMPARE(batchFinishedSpy.count(), 1);
+    QCOMPARE(batchFinishedSpy.at(0).at(0).toUInt(), batch);
+    QCOMPARE(playCalledSpy.count(), 2);
+    QCOMPARE(eventPlayingSpy.count(), 2);
+
+    // State requests are batched too
+    batchFinishedSpy.clear();
+
+    const quint32 stopBatch = m_client->beginBatch();
+    QVERIFY(stopBatch != batch);
+    QVERIFY(m_client->stop(first));
+    QVERIFY(m_client->stop(second));
+    QVERIFY(m_client->commitBatch().isEmpty());
+
+    QVERIFY(waitForSignal(&batchFinishedSpy));
+    QCOMPARE(batchFinishedSpy.at(0).at(0).toUInt(), stopBatch);
+    QTRY_COMPARE(eventCompletedSpy.count(), 2);
+}
+
+void UtClient::testCoalesceStateRequests()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    SignalSpy pauseCalledSpy(&mockService, SIGNAL(mock_pauseCalled(quint32,bool)));
+    SignalSpy stopCalledSpy(&mockService, SIGNAL(mock_stopCalled(uint)));
+    SignalSpy eventPlayingSpy(m_client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventPausedSpy(m_client, SIGNAL(eventPaused(quint32)));
+    SignalSpy eventCompletedSpy(m_client, SIGNAL(eventCompleted(quint32)));
+
+    const quint32 id = m_client->play("a-coalesced-event");
+    QVERIFY(id > 0);
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+
+    const QVariantMap before = m_client->statistics();
+
+    // Only the last wanted state is sent
+    QVERIFY(m_client->pause(id));
+    QVERIFY(m_client->resume(id));
+    QVERIFY(m_client->pause(id));
+
+    QVERIFY(waitForSignals(SignalSpyList() << &eventPausedSpy << &pauseCalledSpy));
+    QCOMPARE(pauseCalledSpy.count(), 1);
+    QCOMPARE(pauseCalledSpy.at(0).at(1).toBool(), true);
+
+    // Requests cancelling each other out aren't sent at all
+    QVERIFY(m_client->resume(id));
+    QVERIFY(m_client->pause(id));
+
+    QTest::qWait(100);
+    QCOMPARE(pauseCalledSpy.count(), 1);
+
+    const QVariantMap after = m_client->statistics();
+    QCOMPARE(after.value("stateRequests").toULongLong(),
+             before.value("stateRequests").toULongLong() + 1);
+    QCOMPARE(after.value("elidedStateRequests").toULongLong(),
+             before.value("elidedStateRequests").toULongLong() + 4);
+
+    // Stopping is final
+    QVERIFY(m_client->stop(id));
+    QVERIFY(m_client->resume(id));
+
+    QVERIFY(waitForSignals(SignalSpyList() << &eventCompletedSpy << &stopCalledSpy));
+    QCOMPARE(pauseCalledSpy.count(), 1);
+}
+
+void UtClient::testSubscribedWhenIdle()
+{
+    SignalSpy eventPlayingSpy(m_client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(m_client, SIGNAL(eventCompleted(quint32)));
+
+    QVERIFY(m_client->isSubscribedWhenIdle());
+    QCOMPARE(m_client->statistics().value("statusSubscribed").toBool(), true);
+
+    m_client->setSubscribedWhenIdle(false);
+    QVERIFY(!m_client->isSubscribedWhenIdle());
+    QCOMPARE(m_client->statistics().value("statusSubscribed").toBool(), false);
+
+    // Status is followed while the client has events
+    const quint32 id = m_client->play("a-lazy-event");
+    QVERIFY(id > 0);
+    QCOMPARE(m_client->statistics().value("statusSubscribed").toBool(), true);
+
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+    QVERIFY(m_client->stop(id));
+    QVERIFY(waitForSignal(&eventCompletedSpy));
+    QCOMPARE(eventCompletedSpy.at(0).at(0).toUInt(), id);
+
+    QCOMPARE(m_client->statistics().value("statusSubscribed").toBool(), false);
+
+    m_client->setSubscribedWhenIdle(true);
+    QCOMPARE(m_client->statistics().value("statusSubscribed").toBool(), true);
+}
+
+void UtClient::testPeerConnection()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    QDBusReply<QString> address = mockService.call("mock_peerAddress");
+    QVERIFY(address.isValid());
+
+    Client peerClient;
+    peerClient.setPeerAddress(address.value());
+    QCOMPARE(peerClient.peerAddress(), address.value());
+    QVERIFY(peerClient.connect());
+    QCOMPARE(peerClient.statistics().value("transport").toString(), QString("peer"));
+
+    SignalSpy playCalledSpy(&mockService, SIGNAL(mock_playCalled(QString,QVariantMap)));
+    SignalSpy eventPlayingSpy(&peerClient, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(&peerClient, SIGNAL(eventCompleted(quint32)));
+
+    const quint32 id = peerClient.play("a-peer-event");
+    QVERIFY(id > 0);
+
+    QVERIFY(waitForSignals(SignalSpyList() << &playCalledSpy << &eventPlayingSpy));
+    QCOMPARE(playCalledSpy.at(0).at(0).toString(), QString("a-peer-event"));
+    QCOMPARE(eventPlayingSpy.at(0).at(0).toUInt(), id);
+
+    QVERIFY(peerClient.stop(id));
+    QVERIFY(waitForSignal(&eventCompletedSpy));
+    QCOMPARE(eventCompletedSpy.at(0).at(0).toUInt(), id);
+
+    // Falls back to the system bus when the peer can't be reached
+    Client fallbackClient;
+    fallbackClient.setPeerAddress("unix:path=/nonexistent/ngfd");
+    QVERIFY(fallbackClient.connect());
+    QCOMPARE(fallbackClient.statistics().value("transport").toString(), QString("bus"));
+}
+
+void UtClient::testPlayFromThread()
+{
+    SignalSpy eventPlayingSpy(m_client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(m_client, SIGNAL(eventCompleted(quint32)));
+
+    const quint64 queued = m_client->statistics().value("queuedRequests").toULongLong();
+
+    PlayThread playThread(m_client);
+    playThread.start();
+    QVERIFY(playThread.wait(SIGNAL_WAIT_TIMEOUT));
+
+    // The id is handed out right away, the request is sent from the client thread
+    QVERIFY(playThread.id > 0);
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+    QCOMPARE(eventPlayingSpy.at(0).at(0).toUInt(), playThread.id);
+
+    StopThread stopThread(m_client, playThread.id);
+    stopThread.start();
+    QVERIFY(stopThread.wait(SIGNAL_WAIT_TIMEOUT));
+
+    QVERIFY(waitForSignal(&eventCompletedSpy));
+    QCOMPARE(eventCompletedSpy.at(0).at(0).toUInt(), playThread.id);
+
+    QCOMPARE(m_client->statistics().value("queuedRequests").toULongLong(), queued + 2);
+}
+
+void UtClient::testThreadedDispatch()
+{
+    Client client;
+
+    client.setThreadedDispatch(true);
+    QVERIFY(client.isThreadedDispatch());
+
+    SignalSpy connectionStatusSpy(&client, SIGNAL(connectionStatus(bool)));
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+
+    QVERIFY(client.connect());
+    QVERIFY(client.isConnected());
+    QCOMPARE(client.statistics().value("threadedDispatch").toBool(), true);
+
+    // Signals are still delivered in the client thread
+    QVERIFY(waitForSignal(&connectionStatusSpy));
+    QCOMPARE(connectionStatusSpy.at(0).at(0).toBool(), true);
+
+    const quint32 id = client.play("a-dispatched-event");
+    QVERIFY(id > 0);
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+    QCOMPARE(eventPlayingSpy.at(0).at(0).toUInt(), id);
+
+    QVERIFY(client.stop(id));
+    QVERIFY(waitForSignal(&eventCompletedSpy));
+    QCOMPARE(eventCompletedSpy.at(0).at(0).toUInt(), id);
+}
+
+void UtClient::testReplyTimeout()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    Client client;
+    QCOMPARE(client.replyTimeout(), 0);
+    client.setReplyTimeout(100);
+    QCOMPARE(client.replyTimeout(), 100);
+    QVERIFY(client.connect());
+
+    SignalSpy eventFailedSpy(&client, SIGNAL(eventFailed(quint32)));
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+    SignalSpy stopCalledSpy(&mockService, SIGNAL(mock_stopCalled(uint)));
+
+    // The event fails when the reply is late, and is stopped once the reply arrives
+    mockService.call("mock_delayNextPlay", 500);
+
+    const quint32 lateId = client.play("a-late-event");
+    QVERIFY(lateId > 0);
+
+    QVERIFY(waitForSignal(&eventFailedSpy));
+    QCOMPARE(eventFailedSpy.at(0).at(0).toUInt(), lateId);
+    QCOMPARE(client.statistics().value("events").toInt(), 0);
+    QCOMPARE(client.statistics().value("replyTimeouts").toULongLong(), 1ull);
+
+    QVERIFY(waitForSignal(&stopCalledSpy));
+    QCOMPARE(eventPlayingSpy.count(), 0);
+    QCOMPARE(client.statistics().value("pendingReplies").toInt(), 0);
+
+    // Timeout given to play overrides the client-wide one
+    mockService.call("mock_delayNextPlay", 300);
+
+    const quint32 patientId = client.play("a-patient-event", QVariantMap(), 0);
+    QVERIFY(patientId > 0);
+
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+    QCOMPARE(eventPlayingSpy.at(0).at(0).toUInt(), patientId);
+    QCOMPARE(eventFailedSpy.count(), 1);
+
+    QVERIFY(client.stop(patientId));
+    QVERIFY(waitForSignal(&eventCompletedSpy));
+    QCOMPARE(eventCompletedSpy.at(0).at(0).toUInt(), patientId);
+}
+
+void UtClient::testInFlightLimit()
+{
+    Client client;
+    QCOMPARE(client.maxInFlight(), 0);
+    QCOMPARE(client.overflowPolicy(), Client::QueueOverflow);
+    client.setMaxInFlight(2);
+    QCOMPARE(client.maxInFlight(), 2);
+    QVERIFY(client.connect());
+
+    SignalSpy congestedSpy(&client, SIGNAL(congested()));
+    SignalSpy drainedSpy(&client, SIGNAL(drained()));
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+
+    // Plays beyond the limit are held back, and sent in order as replies arrive
+    QList<quint32> ids;
+    for (int i = 0; i < 5; ++i)
+        ids.append(client.play(QString("a-held-event-%1").arg(i)));
+
+    QVERIFY(!ids.contains(0));
+    QCOMPARE(congestedSpy.count(), 1);
+    QCOMPARE(client.statistics().value("inFlight").toInt(), 2);
+    QCOMPARE(client.statistics().value("queueDepth").toInt(), 3);
+
+    QTRY_COMPARE(eventPlayingSpy.count(), ids.count());
+    for (int i = 0; i < ids.count(); ++i)
+        QCOMPARE(eventPlayingSpy.at(i).at(0).toUInt(), ids.at(i));
+
+    QCOMPARE(drainedSpy.count(), 1);
+    QCOMPARE(client.statistics().value("queueDepth").toInt(), 0);
+
+    // Plays are refused while congested with the reject policy
+    client.setOverflowPolicy(Client::RejectOverflow);
+    QCOMPARE(client.overflowPolicy(), Client::RejectOverflow);
+
+    ids.append(client.play("a-rejectable-event-0"));
+    ids.append(client.play("a-rejectable-event-1"));
+    QVERIFY(!ids.contains(0));
+    QCOMPARE(congestedSpy.count(), 2);
+
+    QCOMPARE(client.play("a-rejected-event"), 0u);
+    QCOMPARE(client.statistics().value("rejectedPlays").toInt(), 1);
+
+    QTRY_COMPARE(drainedSpy.count(), 2);
+    QTRY_COMPARE(eventPlayingSpy.count(), ids.count());
+
+    for (int i = 0; i < ids.count(); ++i)
+        QVERIFY(client.stop(ids.at(i)));
+
+    QTRY_COMPARE(eventCompletedSpy.count(), ids.count());
+}
+
+void UtClient::testRateLimit()
+{
+    Client client;
+    QVERIFY(client.connect());
+
+    // Slow enough rate not to refill a token during the test
+    client.setRateLimit("a-limited-event", 0.1, 2);
+
+    SignalSpy eventDroppedSpy(&client, SIGNAL(eventDropped(QString)));
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+
+    // Plays within the burst go through
+    for (int i = 0; i < 2; ++i) {
+        const quint32 id = client.play("a-limited-event");
+        QVERIFY(id > 0);
+        QTRY_COMPARE(eventPlayingSpy.count(), i + 1);
+        QVERIFY(client.stop(id));
+        QTRY_COMPARE(eventCompletedSpy.count(), i + 1);
+    }
+
+    // Excess plays are dropped without sending anything
+    QCOMPARE(client.play("a-limited-event"), 0u);
+    QVERIFY(client.playDetached("a-limited-event"));
+
+    QCOMPARE(eventDroppedSpy.count(), 2);
+    QCOMPARE(eventDroppedSpy.at(0).at(0).toString(), QString("a-limited-event"));
+    QCOMPARE(client.statistics().value("droppedPlays").toInt(), 2);
+    QCOMPARE(client.statistics().value("plays").toInt(), 2);
+
+    // Removing the limit lets plays through again
+    client.setRateLimit("a-limited-event", 0);
+
+    const quint32 id = client.play("a-limited-event");
+    QVERIFY(id > 0);
+    QTRY_COMPARE(eventPlayingSpy.count(), 3);
+    QVERIFY(client.stop(id));
+    QTRY_COMPARE(eventCompletedSpy.count(), 3);
+    QCOMPARE(eventDroppedSpy.count(), 2);
+}
+
+void UtClient::testFailureCache()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    Client client;
+    QVERIFY(client.connect());
+
+    QVariantMap properties;
+    properties["media.vibra"] = true;
+
+    SignalSpy eventFailedSpy(&client, SIGNAL(eventFailed(quint32)));
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+
+    // Event failing right away again and again gets noted
+    for (int i = 0; i < 2; ++i) {
+        mockService.call("mock_failNextPlay");
+        QVERIFY(client.play("a-failing-event", properties) > 0);
+        QTRY_COMPARE(eventFailedSpy.count(), i + 1);
+    }
+
+    QCOMPARE(client.statistics().value("failureCacheEntries").toInt(), 1);
+
+    // Then it fails without being sent to the daemon
+    SignalSpy playCalledSpy(&mockService, SIGNAL(mock_playCalled(QString,QVariantMap)));
+
+    const quint32 cachedId = client.play("a-failing-event", properties);
+    QVERIFY(cachedId > 0);
+    QTRY_COMPARE(eventFailedSpy.count(), 3);
+    QCOMPARE(eventFailedSpy.at(2).at(0).toUInt(), cachedId);
+    QCOMPARE(client.statistics().value("shortCircuitedPlays").toInt(), 1);
+
+    // Same event with other properties is still sent
+    const quint32 id = client.play("a-failing-event");
+    QVERIFY(id > 0);
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+    QCOMPARE(eventPlayingSpy.at(0).at(0).toUInt(), id);
+    QCOMPARE(playCalledSpy.count(), 1);
+
+    QVERIFY(client.stop(id));
+    QVERIFY(waitForSignal(&eventCompletedSpy));
+
+    // Properties differing only inside a list are told apart
+    QVariantMap listProperties;
+    listProperties["media.list"] = QStringList() << "a" << "b";
+
+    for (int i = 0; i < 2; ++i) {
+        mockService.call("mock_failNextPlay");
+        QVERIFY(client.play("a-failing-event", listProperties) > 0);
+        QTRY_COMPARE(eventFailedSpy.count(), i + 4);
+    }
+
+    QCOMPARE(client.statistics().value("failureCacheEntries").toInt(), 2);
+
+    listProperties["media.list"] = QStringList() << "a" << "c";
+    const quint32 listId = client.play("a-failing-event", listProperties);
+    QVERIFY(listId > 0);
+    QTRY_COMPARE(eventPlayingSpy.count(), 2);
+    QCOMPARE(eventPlayingSpy.at(1).at(0).toUInt(), listId);
+
+    QVERIFY(client.stop(listId));
+    QTRY_COMPARE(eventCompletedSpy.count(), 2);
+
+    // Cache is forgotten when the daemon changes
+    mockService.call("mock_disconnectForAWhile");
+    QTRY_COMPARE(client.statistics().value("failureCacheEntries").toInt(), 0);
+}
+
+void UtClient::testEarlyStatus()
+{
+    const int EventCount = 20;
+
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    Client client;
+    QVERIFY(client.connect());
+
+    SignalSpy eventFailedSpy(&client, SIGNAL(eventFailed(quint32)));
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+
+    // Events completing before NGF daemon replies to their play requests
+    mockService.call("mock_completeNextPlaysEarly", EventCount);
+
+    QList<quint32> ids;
+    for (int i = 0; i < EventCount; ++i) {
+        const quint32 id = client.play("early-event");
+        QVERIFY(id > 0);
+        ids.append(id);
+    }
+
+    QTRY_COMPARE(eventCompletedSpy.count(), EventCount);
+
+    for (int i = 0; i < EventCount; ++i) {
+        QCOMPARE(eventPlayingSpy.at(i).at(0).toUInt(), ids.at(i));
+        QCOMPARE(eventCompletedSpy.at(i).at(0).toUInt(), ids.at(i));
+    }
+
+    QCOMPARE(eventFailedSpy.count(), 0);
+    QCOMPARE(client.statistics().value("events").toInt(), 0);
+    QCOMPARE(client.statistics().value("earlyStatuses").toInt(), EventCount);
+}
+
+void UtClient::testEventSweeper()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    Client client;
+    QVERIFY(client.connect());
+
+    SignalSpy eventFailedSpy(&client, SIGNAL(eventFailed(quint32)));
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy stopCalledSpy(&mockService, SIGNAL(mock_stopCalled(quint32)));
+
+    // Event the daemon never tells anything more of is reclaimed
+    client.setStaleEventTimeout(500);
+    QCOMPARE(client.staleEventTimeout(), 500);
+
+    const quint32 staleId = client.play("stale-event");
+    QVERIFY(staleId > 0);
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+
+    QTRY_COMPARE(eventFailedSpy.count(), 1);
+    QCOMPARE(eventFailedSpy.at(0).at(0).toUInt(), staleId);
+    QCOMPARE(client.statistics().value("events").toInt(), 0);
+    QCOMPARE(client.statistics().value("sweptEvents").toInt(), 1);
+    QVERIFY(client.statistics().value("sweeps").toInt() > 0);
+
+    // It is stopped at the daemon as well
+    QTRY_COMPARE(stopCalledSpy.count(), 1);
+
+    // Going over the table size limit reclaims one of the events
+    client.setStaleEventTimeout(0);
+    client.setMaxEvents(2);
+    QCOMPARE(client.maxEvents(), 2);
+
+    QList<quint32> ids;
+    ids << client.play("sweep-event-1") << client.play("sweep-event-2") << client.play("sweep-event-3");
+    QVERIFY(!ids.contains(0));
+
+    QTRY_COMPARE(eventFailedSpy.count(), 2);
+    QVERIFY(ids.contains(eventFailedSpy.at(1).at(0).toUInt()));
+    QCOMPARE(client.statistics().value("events").toInt(), 2);
+    QCOMPARE(client.statistics().value("sweptEvents").toInt(), 2);
+    QTRY_COMPARE(stopCalledSpy.count(), 2);
+
+    for (int i = 0; i < ids.count(); ++i)
+        client.stop(ids.at(i));
+    QTRY_COMPARE(client.statistics().value("events").toInt(), 0);
+}
+
+void UtClient::testEventState()
+{
+    Client client;
+    QVERIFY(client.connect());
+
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventPausedSpy(&client, SIGNAL(eventPaused(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+
+    QCOMPARE(client.state(12345), Client::EventUnknown);
+    QVERIFY(client.activeEvents().isEmpty());
+
+    const quint32 id = client.play("state-event");
+    QVERIFY(id > 0);
+    QCOMPARE(client.state(id), Client::EventStarting);
+    QCOMPARE(client.activeEvents(), QList<quint32>() << id);
+
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+    QCOMPARE(client.state(id), Client::EventPlaying);
+
+    // Pausing shows once the daemon has paused the event
+    QVERIFY(client.pause(id));
+    QCOMPARE(client.state(id), Client::EventPlaying);
+    QVERIFY(waitForSignal(&eventPausedSpy));
+    QCOMPARE(client.state(id), Client::EventPaused);
+
+    // Stopping shows right away
+    QVERIFY(client.stop(id));
+    QCOMPARE(client.state(id), Client::EventStopping);
+    QVERIFY(client.activeEvents().isEmpty());
+
+    QVERIFY(waitForSignal(&eventCompletedSpy));
+    QCOMPARE(client.state(id), Client::EventUnknown);
+}
+
+void UtClient::testEventHandle()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    Client client;
+    QVERIFY(client.connect());
+
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventPausedSpy(&client, SIGNAL(eventPaused(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+    SignalSpy stopCalledSpy(&mockService, SIGNAL(mock_stopCalled(quint32)));
+
+    QVERIFY(!EventHandle().isValid());
+
+    quint32 id;
+
+    {
+        EventHandle handle = client.playHandle("handle-event");
+        QVERIFY(handle.isValid());
+        id = handle.id();
+        QVERIFY(id > 0);
+
+        QVERIFY(waitForSignal(&eventPlayingSpy));
+        QCOMPARE(handle.state(), Client::EventPlaying);
+
+        QVERIFY(handle.pause());
+        QVERIFY(waitForSignal(&eventPausedSpy));
+        QCOMPARE(eventPausedSpy.at(0).at(0).toUInt(), id);
+        QCOMPARE(handle.state(), Client::EventPaused);
+
+        // Moving hands the event over without stopping it
+        EventHandle other(std::move(handle));
+        QVERIFY(!handle.isValid());
+        QCOMPARE(other.id(), id);
+
+        QVERIFY(other.resume());
+        QTRY_COMPARE(eventPlayingSpy.count(), 2);
+        QCOMPARE(other.state(), Client::EventPlaying);
+        QCOMPARE(stopCalledSpy.count(), 0);
+    }
+
+    // Handle going out of scope stops its event
+    QVERIFY(waitForSignal(&eventCompletedSpy));
+    QCOMPARE(eventCompletedSpy.at(0).at(0).toUInt(), id);
+    QCOMPARE(stopCalledSpy.count(), 1);
+
+    // Detached event plays on
+    {
+        EventHandle handle = client.playHandle("detached-handle-event");
+        QTRY_COMPARE(eventPlayingSpy.count(), 3);
+        id = handle.detach();
+        QVERIFY(!handle.isValid());
+    }
+
+    QTest::qWait(100);
+    QCOMPARE(client.state(id), Client::EventPlaying);
+    QCOMPARE(stopCalledSpy.count(), 1);
+
+    QVERIFY(client.stop(id));
+    QTRY_COMPARE(eventCompletedSpy.count(), 2);
+}
+
+void UtClient::testPlayAsync()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    Client client;
+    QVERIFY(client.connect());
+
+    // Future progresses when the event starts and finishes when it ends
+    QFuture<Client::EventResult> future = client.playAsync("async-event");
+    QVERIFY(!future.isFinished());
+    QTRY_COMPARE(future.progressValue(), 1);
+    QVERIFY(!future.isFinished());
+
+    mockService.call("mock_stop", "async-event");
+    QTRY_VERIFY(future.isFinished());
+    QCOMPARE(future.result(), Client::ResultCompleted);
+
+    // Failing event
+    mockService.call("mock_failNextPlay");
+    future = client.playAsync("async-failing-event");
+    QTRY_VERIFY(future.isFinished());
+    QCOMPARE(future.result(), Client::ResultFailed);
+    QCOMPARE(future.progressValue(), 0);
+
+    // Event which can't be played at all
+    client.setRateLimit("async-dropped-event", 1, 1);
+    future = client.playAsync("async-dropped-event");
+    client.stop("async-dropped-event");
+    future = client.playAsync("async-dropped-event");
+    QVERIFY(future.isFinished());
+    QCOMPARE(future.result(), Client::ResultFailed);
+
+    QTRY_COMPARE(client.statistics().value("events").toInt(), 0);
+}
+
+void UtClient::testSharedStatus()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    // Clients of a thread share the status subscription with the test case client
+    const int shared = m_client->statistics().value("sharedClients").toInt();
+    QVERIFY(shared > 0);
+
+    Client first;
+    QVERIFY(first.connect());
+
+    SignalSpy firstPlayingSpy(&first, SIGNAL(eventPlaying(quint32)));
+    SignalSpy firstCompletedSpy(&first, SIGNAL(eventCompleted(quint32)));
+
+    {
+        Client second;
+        QVERIFY(second.connect());
+        QCOMPARE(first.statistics().value("sharedClients").toInt(), shared + 2);
+
+        SignalSpy secondPlayingSpy(&second, SIGNAL(eventPlaying(quint32)));
+        SignalSpy secondCompletedSpy(&second, SIGNAL(eventCompleted(quint32)));
+
+        const quint32 firstId = first.play("first-shared-event");
+        const quint32 secondId = second.play("second-shared-event");
+        QVERIFY(firstId > 0);
+        QVERIFY(secondId > 0);
+
+        QTRY_COMPARE(firstPlayingSpy.count(), 1);
+        QTRY_COMPARE(secondPlayingSpy.count(), 1);
+        QCOMPARE(firstPlayingSpy.at(0).at(0).toUInt(), firstId);
+        QCOMPARE(secondPlayingSpy.at(0).at(0).toUInt(), secondId);
+
+        // Each client hears only of its own events
+        mockService.call("mock_stop", "second-shared-event");
+        QVERIFY(waitForSignal(&secondCompletedSpy));
+        QCOMPARE(secondCompletedSpy.at(0).at(0).toUInt(), secondId);
+        QCOMPARE(first.state(firstId), Client::EventPlaying);
+
+        mockService.call("mock_stop", "first-shared-event");
+        QVERIFY(waitForSignal(&firstCompletedSpy));
+        QCOMPARE(firstCompletedSpy.at(0).at(0).toUInt(), firstId);
+        QCOMPARE(secondCompletedSpy.count(), 1);
+    }
+
+    QCOMPARE(first.statistics().value("sharedClients").toInt(), shared + 1);
+}
+
+void UtClient::testRecovery()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    Client client;
+    QVERIFY(client.connect());
+    QVERIFY(!client.isRecoveryEnabled());
+    client.setRecoveryEnabled(true);
+    QVERIFY(client.isRecoveryEnabled());
+
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventPausedSpy(&client, SIGNAL(eventPaused(quint32)));
+    SignalSpy eventFailedSpy(&client, SIGNAL(eventFailed(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+    SignalSpy playCalledSpy(&mockService, SIGNAL(mock_playCalled(QString,QVariantMap)));
+
+    QVariantMap properties;
+    properties["repeat"] = true;
+
+    const quint32 ringtone = client.play("recovered-ringtone", properties);
+    const quint32 paused = client.play("recovered-paused-event");
+    QTRY_COMPARE(eventPlayingSpy.count(), 2);
+    QVERIFY(client.pause(paused));
+    QVERIFY(waitForSignal(&eventPausedSpy));
+    eventPlayingSpy.clear();
+    eventPausedSpy.clear();
+    playCalledSpy.clear();
+
+    // Events are played again in their wanted state when the daemon is back
+    mockService.call("mock_restart");
+
+    QTRY_COMPARE(eventPlayingSpy.count(), 2);
+    QTRY_COMPARE(eventPausedSpy.count(), 1);
+    QCOMPARE(eventPausedSpy.at(0).at(0).toUInt(), paused);
+    QCOMPARE(playCalledSpy.count(), 2);
+    QCOMPARE(eventFailedSpy.count(), 0);
+
+    QDBusReply<QVariantMap> replayed = mockService.call("mock_properties", "recovered-ringtone");
+    QVERIFY(replayed.isValid());
+    QCOMPARE(replayed.value(), properties);
+    QDBusReply<bool> isPaused = mockService.call("mock_isPaused", "recovered-paused-event");
+    QVERIFY(isPaused.isValid());
+    QVERIFY(isPaused.value());
+
+    QCOMPARE(client.state(ringtone), Client::EventPlaying);
+    QCOMPARE(client.state(paused), Client::EventPaused);
+
+    const QVariantMap stats = client.statistics();
+    QCOMPARE(stats.value("recoveries").toInt(), 1);
+    QCOMPARE(stats.value("recoveredEvents").toInt(), 2);
+    QVERIFY(stats.value("outageTime").toLongLong() >= 0);
+    QVERIFY(stats.value("recoveryTime").toLongLong() >= 0);
+
+    // Recovered events are followed like any other
+    QVERIFY(client.stop(ringtone));
+    QVERIFY(client.stop(paused));
+    QTRY_COMPARE(eventCompletedSpy.count(), 2);
+    QTRY_COMPARE(client.statistics().value("events").toInt(), 0);
+}
+
+void UtClient::testOfflineQueue()
+{
+    // The mock is reached through its unique name while it has no service name
+    QDBusReply<QString> owner = bus().interface()->serviceOwner(service());
+    QVERIFY(owner.isValid());
+    QDBusInterface mockService(owner.value(), path(), interface(), bus());
+
+    Client client;
+    QVERIFY(client.connect());
+    QCOMPARE(client.maxOfflinePlays(), 0);
+    client.setMaxOfflinePlays(2);
+    QCOMPARE(client.maxOfflinePlays(), 2);
+    client.setOfflineTimeout(200);
+    QCOMPARE(client.offlineTimeout(), 200);
+
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventFailedSpy(&client, SIGNAL(eventFailed(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+    SignalSpy playCalledSpy(&mockService, SIGNAL(mock_playCalled(QString,QVariantMap)));
+
+    mockService.call("mock_unregister");
+    QTRY_VERIFY(!client.statistics().value("serviceAvailable").toBool());
+
+    const quint32 expiring = client.play("offline-expiring-event");
+    client.setOfflineTimeout(0);
+    const quint32 waiting = client.play("offline-event");
+    const quint32 overflowing = client.play("offline-overflowing-event");
+    QVERIFY(expiring > 0);
+    QVERIFY(waiting > 0);
+    QVERIFY(overflowing > 0);
+    QCOMPARE(client.state(waiting), Client::EventStarting);
+
+    // Play over the limit fails right away, the first one at its deadline
+    QVERIFY(waitForSignal(&eventFailedSpy));
+    QCOMPARE(eventFailedSpy.at(0).at(0).toUInt(), overflowing);
+    QTRY_COMPARE(eventFailedSpy.count(), 2);
+    QCOMPARE(eventFailedSpy.at(1).at(0).toUInt(), expiring);
+    QCOMPARE(playCalledSpy.count(), 0);
+
+    QVariantMap stats = client.statistics();
+    QCOMPARE(stats.value("offlineQueueDepth").toInt(), 1);
+    QCOMPARE(stats.value("offlineOverflows").toInt(), 1);
+    QCOMPARE(stats.value("offlineExpiredPlays").toInt(), 1);
+
+    // Waiting play goes out once the daemon is there
+    mockService.call("mock_register");
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+    QCOMPARE(eventPlayingSpy.at(0).at(0).toUInt(), waiting);
+    QCOMPARE(playCalledSpy.count(), 1);
+
+    stats = client.statistics();
+    QVERIFY(stats.value("serviceAvailable").toBool());
+    QCOMPARE(stats.value("offlinePlays").toInt(), 2);
+    QCOMPARE(stats.value("offlineQueueDepth").toInt(), 0);
+
+    QVERIFY(client.stop(waiting));
+    QVERIFY(waitForSignal(&eventCompletedSpy));
+    QCOMPARE(eventFailedSpy.count(), 2);
+}
+
+void UtClient::testServiceOwner()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+    QDBusReply<QString> owner = bus().interface()->serviceOwner(service());
+    QVERIFY(owner.isValid());
+
+    Client client;
+    QVERIFY(!client.isEagerOwnerLookup());
+    client.setEagerOwnerLookup(true);
+    QVERIFY(client.isEagerOwnerLookup());
+    QVERIFY(client.connect());
+
+    // Known right after connecting
+    QCOMPARE(client.statistics().value("serviceOwner").toString(), owner.value());
+
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventPausedSpy(&client, SIGNAL(eventPaused(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+
+    // Calls addressed to the owner are served like any other
+    const quint32 id = client.play("owner-event");
+    QVERIFY(id > 0);
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+    QVERIFY(client.pause(id));
+    QVERIFY(waitForSignal(&eventPausedSpy));
+
+    // Owner is forgotten while the daemon is away and learnt again when it is back
+    mockService.call("mock_restart");
+    QTRY_COMPARE(client.statistics().value("events").toInt(), 0);
+    QTRY_COMPARE(client.statistics().value("serviceOwner").toString(), owner.value());
+
+    const quint32 next = client.play("owner-event");
+    QVERIFY(next > 0);
+    QTRY_COMPARE(eventPlayingSpy.count(), 2);
+    QCOMPARE(eventPlayingSpy.at(1).at(0).toUInt(), next);
+
+    QVERIFY(client.stop(next));
+    QVERIFY(waitForSignal(&eventCompletedSpy));
+    QCOMPARE(eventCompletedSpy.at(0).at(0).toUInt(), next);
+}
+
+void UtClient::testPrivateConnection()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    const int shared = m_client->statistics().value("sharedClients").toInt();
+
+    Client client;
+    QVERIFY(!client.isPrivateConnection());
+    client.setPrivateConnection(true);
+    QVERIFY(client.isPrivateConnection());
+    QVERIFY(client.connect());
+
+    // Status subscription is not shared over connections
+    QVariantMap stats = client.statistics();
+    QCOMPARE(stats.value("transport").toString(), QString("private"));
+    QCOMPARE(stats.value("sharedClients").toInt(), 1);
+    QCOMPARE(m_client->statistics().value("sharedClients").toInt(), shared);
+
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy eventPausedSpy(&client, SIGNAL(eventPaused(quint32)));
+    SignalSpy eventCompletedSpy(&client, SIGNAL(eventCompleted(quint32)));
+
+    const quint32 id = client.play("private-connection-event");
+    QVERIFY(id > 0);
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+    QVERIFY(client.pause(id));
+    QVERIFY(waitForSignal(&eventPausedSpy));
+
+    QDBusReply<bool> paused = mockService.call("mock_isPaused", "private-connection-event");
+    QVERIFY(paused.isValid());
+    QVERIFY(paused.value());
+
+    mockService.call("mock_stop", "private-connection-event");
+    QVERIFY(waitForSignal(&eventCompletedSpy));
+    QCOMPARE(eventCompletedSpy.at(0).at(0).toUInt(), id);
+}
+
+void UtClient::testStopBeforeDelete()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+    SignalSpy stopCalledSpy(&mockService, SIGNAL(mock_stopCalled(quint32)));
+
+    Client *client = new Client;
+    QVERIFY(client->connect());
+
+    SignalSpy eventPlayingSpy(client, SIGNAL(eventPlaying(quint32)));
+
+    const quint32 id = client->play("deleted-client-event");
+    QVERIFY(id > 0);
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+
+    QDBusReply<quint32> serverId = mockService.call("mock_id", "deleted-client-event");
+    QVERIFY(serverId.isValid());
+
+    // Stop is sent although the client is gone before the event loop runs again
+    QVERIFY(client->stop(id));
+    delete client;
+
+    QVERIFY(waitForSignal(&stopCalledSpy));
+    QCOMPARE(stopCalledSpy.at(0).at(0).toUInt(), serverId.value());
+}
+
+void UtClient::testRepliesOutOfOrder()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+    SignalSpy playCalledSpy(&mockService, SIGNAL(mock_playCalled(QString,QVariantMap)));
+    SignalSpy stopCalledSpy(&mockService, SIGNAL(mock_stopCalled(uint)));
+
+    Client client;
+    QVERIFY(client.connect());
+
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+
+    // The first play is replied to after the second one
+    mockService.call("mock_delayNextPlay", 300);
+    const quint32 slowId = client.play("a-slow-event", QVariantMap(), 0);
+    QVERIFY(slowId > 0);
+    QVERIFY(waitForSignal(&playCalledSpy));
+
+    mockService.call("mock_delayNextPlay", 50);
+    const quint32 quickId = client.play("a-quick-event", QVariantMap(), 0);
+    QVERIFY(quickId > 0);
+
+    QTRY_COMPARE(eventPlayingSpy.count(), 2);
+    QCOMPARE(eventPlayingSpy.at(0).at(0).toUInt(), quickId);
+    QCOMPARE(eventPlayingSpy.at(1).at(0).toUInt(), slowId);
+
+    // Each event got the server id of its own play
+    QDBusReply<quint32> slowServerId = mockService.call("mock_id", "a-slow-event");
+    QVERIFY(slowServerId.isValid());
+
+    QVERIFY(client.stop(slowId));
+    QVERIFY(waitForSignal(&stopCalledSpy));
+    QCOMPARE(stopCalledSpy.at(0).at(0).toUInt(), slowServerId.value());
+
+    QVERIFY(client.stop(quickId));
+}
+
+void UtClient::testHandleStateOffThread()
+{
+    Client client;
+    QVERIFY(client.connect());
+
+    Client threadedClient;
+    threadedClient.setThreadedDispatch(true);
+    QVERIFY(threadedClient.connect());
+
+    SignalSpy eventPlayingSpy(&client, SIGNAL(eventPlaying(quint32)));
+    SignalSpy threadedPlayingSpy(&threadedClient, SIGNAL(eventPlaying(quint32)));
+
+    EventHandle handle = client.playHandle("off-thread-state-event");
+    EventHandle threadedHandle = threadedClient.playHandle("off-thread-threaded-event");
+    QVERIFY(waitForSignal(&eventPlayingSpy));
+    QVERIFY(waitForSignal(&threadedPlayingSpy));
+
+    // Other threads can't look into the event table of the client thread
+    HandleStateThread thread(&handle);
+    thread.start();
+    QVERIFY(thread.wait(5000));
+    QCOMPARE(thread.state, Client::EventUnknown);
+    QCOMPARE(handle.state(), Client::EventPlaying);
+
+    // The dispatch thread is asked instead
+    HandleStateThread threadedThread(&threadedHandle);
+    threadedThread.start();
+    QVERIFY(threadedThread.wait(5000));
+    QCOMPARE(threadedThread.state, Client::EventPlaying);
+}
+
+void UtClient::testDeleteClientOnStatus()
+{
+    QDBusInterface mockService(service(), path(), interface(), bus());
+
+    const int shared = m_client->statistics().value("sharedClients").toInt();
+
+    Client *doomed = new Client;
+    QVERIFY(doomed->connect());
+
+    Client survivor;
+    QVERIFY(survivor.connect());
+
+    SignalSpy doomedPlayingSpy(doomed, SIGNAL(eventPlaying(quint32)));
+    SignalSpy survivorPlayingSpy(&survivor, SIGNAL(eventPlaying(quint32)));
+    SignalSpy survivorCompletedSpy(&survivor, SIGNAL(eventCompleted(quint32)));
+
+    // The client goes away while the shared hub is handing it the status
+    QObject::connect(doomed, &Client::eventCompleted, [&doomed]() {
+        delete doomed;
+        doomed = 0;
+    });
+
+    QVERIFY(doomed->play("doomed-client-event") > 0);
+    const quint32 survivorId = survivor.play("surviving-client-event");
+    QVERIFY(survivorId > 0);
+
+    QVERIFY(waitForSignal(&doomedPlayingSpy));
+    QTRY_COMPARE(survivorPlayingSpy.count(), 1);
+
+    mockService.call("mock_stop", "doomed-client-event");
+    QTRY_VERIFY(!doomed);
+    QCOMPARE(survivor.statistics().value("sharedClients").toInt(), shared + 1);
+
+    // The hub goes on routing statuses to the remaining clients
+    mockService.call("mock_stop", "surviving-client-event");
+    QVERIFY(waitForSignal(&survivorCompletedSpy));
+    QCOMPARE(survivorCompletedSpy.at(0).at(0).toUInt(), survivorId);
+}
+
 TEST_MAIN(UtClient)
 
 #include "ut_client.moc"